@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <functional>
+#include <vector>
+
+// Bump allocator for immutable strings. Blocks are never moved or freed before the arena,
+// so the views it hands out stay valid for its lifetime; there is no per-string header.
+class StringArena {
+public:
+    // Uninitialized space for n bytes (nullptr for n == 0).
+    char* allocate(size_t n) {
+        if (n == 0) return nullptr;
+        if (n > left) {
+            // oversized requests get a block of their own and leave the current one open
+            size_t size = std::max(kBlockSize, n);
+            blocks.emplace_back(new char[size]);
+            reserved += size;
+            if (n >= kBlockSize) return blocks.back().get();
+            cur = blocks.back().get();
+            left = size;
+        }
+        char* at = cur;
+        cur += n;
+        left -= n;
+        return at;
+    }
+
+    std::string_view store(std::string_view s) {
+        char* at = allocate(s.size());
+        if (at) std::memcpy(at, s.data(), s.size());
+        return std::string_view(at, s.size());
+    }
+
+    // Bytes taken from the heap (including the unused tail of the current block).
+    size_t bytesReserved() const { return reserved + blocks.capacity() * sizeof(blocks[0]); }
+
+private:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cur{nullptr};
+    size_t left{0};
+    size_t reserved{0};
+};
+
+// Interning pool: every distinct string is stored once and named by a dense id. Id 0 is the
+// empty string. Lookups go through an open-addressing table of ids (linear probing, at most
+// half full) that keeps each string's hash, so a probe rarely touches the string itself.
+class StringPool {
+public:
+    StringPool() {
+        strings.push_back(std::string_view());
+        hashes.push_back(0);
+    }
+
+    uint32_t intern(std::string_view s) {
+        if (s.empty()) return 0;
+        uint64_t h = std::hash<std::string_view>()(s);
+        size_t i = probe(s, h);
+        if (i < slots.size() && slots[i] != 0) return slots[i];
+        uint32_t id = static_cast<uint32_t>(strings.size());
+        strings.push_back(text.store(s));
+        hashes.push_back(h);
+        if (2 * strings.size() > slots.size()) {
+            rehash(slots.empty() ? 64 : 2 * slots.size());
+        } else {
+            slots[i] = id;
+        }
+        return id;
+    }
+
+    // Id of a string already in the pool, or -1.
+    int64_t find(std::string_view s) const {
+        if (s.empty()) return 0;
+        size_t i = probe(s, std::hash<std::string_view>()(s));
+        return i < slots.size() && slots[i] != 0 ? static_cast<int64_t>(slots[i]) : -1;
+    }
+
+    std::string_view operator[](uint32_t id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+
+    size_t bytesReserved() const {
+        return text.bytesReserved() + strings.capacity() * sizeof(std::string_view) +
+               hashes.capacity() * sizeof(uint64_t) + slots.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    StringArena text;
+    std::vector<std::string_view> strings;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> slots; // id, or 0 for an empty slot; size is a power of two
+
+    // Slot holding s, or the empty slot where it would go (slots.size() when there are none).
+    size_t probe(std::string_view s, uint64_t h) const {
+        if (slots.empty()) return 0;
+        size_t mask = slots.size() - 1;
+        for (size_t i = static_cast<size_t>(h) & mask;; i = (i + 1) & mask) {
+            uint32_t id = slots[i];
+            if (id == 0 || (hashes[id] == h && strings[id] == s)) return i;
+        }
+    }
+
+    void rehash(size_t size) {
+        slots.assign(size, 0);
+        size_t mask = size - 1;
+        for (uint32_t id = 1; id < strings.size(); ++id) {
+            size_t i = static_cast<size_t>(hashes[id]) & mask;
+            while (slots[i] != 0) i = (i + 1) & mask;
+            slots[i] = id;
+        }
+    }
+};
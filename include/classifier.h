@@ -0,0 +1,280 @@
+#pragma once
+#include "matcher.h"
+#include "ngram_index.h"
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Multinomial naive Bayes over hashed text features, used by CategorizerService to suggest a
+// category (label) from a transaction's merchant and notes.
+//
+// Features, after the same case folding as the keyword matcher:
+//   - the merchant as a whole, ignoring digits, spaces and punctuation ("Walmart #12" and
+//     "WALMART #7" are one feature)
+//   - every word of the merchant and of the notes (runs of letters and digits; all-digit runs
+//     such as branch or order numbers are dropped), merchant and notes words kept apart
+//   - for CJK text, which has no spaces, every character and every pair of adjacent characters
+// Each feature is hashed into one of 2^bits buckets, so memory does not grow with the
+// vocabulary and unseen words need no dictionary.
+//
+// The model keeps, per bucket, a row of counts and of log-weights with one entry per label,
+// so scoring a transaction adds a handful of contiguous rows (the compiler vectorizes the
+// adds). Counts are exact: learn() and forget() undo each other, which is how a
+// recategorization is applied incrementally. Buckets no training row has touched carry no
+// evidence and are skipped, so a transaction with nothing known about it gets no label.
+//
+// Confidence is the posterior probability of the winning label (softmax over the labels'
+// log-scores) times the share of the transaction's features the model has seen before:
+// naive Bayes is near certain on a single familiar word, and a new merchant judged on one
+// word of its notes should not clear an import threshold.
+//
+// Not thread-safe for writes; predict() may run on several threads at once, each with its
+// own Scratch, while nothing is learned.
+class NaiveBayesModel {
+public:
+    struct Prediction {
+        int32_t label{-1}; // -1: no evidence, or no enabled label
+        double confidence{0};
+    };
+
+    // Per-thread buffers for predict.
+    struct Scratch {
+        std::vector<uint32_t> codePoints;
+        std::vector<uint32_t> buckets;
+        std::vector<uint32_t> offsets;
+        std::vector<float> scores;
+    };
+
+    explicit NaiveBayesModel(unsigned bits = 16): bits(bits), known(size_t(1) << bits, 0) {}
+
+    // Label index of a name, added on first use.
+    int32_t label(const std::string& name) {
+        for (size_t i = 0; i < names.size(); ++i) if (names[i] == name) return static_cast<int32_t>(i);
+        names.push_back(name);
+        docs.push_back(0);
+        tokens.push_back(0);
+        if (names.size() > stride) grow();
+        return static_cast<int32_t>(names.size() - 1);
+    }
+    int32_t findLabel(const std::string& name) const {
+        for (size_t i = 0; i < names.size(); ++i) if (names[i] == name) return static_cast<int32_t>(i);
+        return -1;
+    }
+    size_t labelCount() const { return names.size(); }
+    const std::string& labelName(size_t label) const { return names[label]; }
+    uint64_t documents() const { return totalDocs; }
+
+    // Count one labelled example (weight -1 takes it back) and update the affected weights.
+    // Taking back more examples than a label has is refused, and no count goes below zero.
+    void learn(std::string_view merchant, std::string_view notes, int32_t label, int weight = 1) {
+        if (weight < 0 && docs[static_cast<size_t>(label)] < static_cast<uint64_t>(-static_cast<int64_t>(weight))) return;
+        Scratch s;
+        features(merchant, notes, s.codePoints, s.buckets);
+        count(s.buckets, static_cast<size_t>(label), weight);
+        for (uint32_t b: s.buckets) refreshCell(b, static_cast<size_t>(label));
+        refreshLabels();
+    }
+    void forget(std::string_view merchant, std::string_view notes, int32_t label) { learn(merchant, notes, label, -1); }
+
+    // Bulk training: count every example, then recompute all weights once.
+    template <class Examples>
+    void train(const Examples& examples) {
+        Scratch s;
+        for (const auto &e: examples) {
+            features(e.merchant, e.notes, s.codePoints, s.buckets);
+            count(s.buckets, static_cast<size_t>(e.label), 1);
+        }
+        rebuild();
+    }
+
+    // Best enabled label for one transaction. enabled[label] == 0 takes a label out of the
+    // running (e.g. its category was deleted); nullptr enables all.
+    Prediction predict(std::string_view merchant, std::string_view notes, Scratch& s, const uint8_t* enabled = nullptr) const {
+        features(merchant, notes, s.codePoints, s.buckets);
+        return score(s.buckets.data(), s.buckets.size(), s, enabled);
+    }
+
+    // Many transactions (anything with merchant and notes, through `get(i)`): features for
+    // the whole batch first, then one scoring pass over the flat bucket list.
+    template <class Get>
+    void predictBatch(size_t n, Get&& get, Prediction* out, Scratch& s, const uint8_t* enabled = nullptr) const {
+        std::vector<uint32_t> all;
+        all.reserve(n * 8);
+        s.offsets.assign(1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            const auto &t = get(i);
+            features(t.merchant, t.notes, s.codePoints, s.buckets);
+            all.insert(all.end(), s.buckets.begin(), s.buckets.end());
+            s.offsets.push_back(static_cast<uint32_t>(all.size()));
+        }
+        for (size_t i = 0; i < n; ++i) out[i] = score(all.data() + s.offsets[i], s.offsets[i + 1] - s.offsets[i], s, enabled);
+    }
+
+    size_t bytesReserved() const {
+        return counts.capacity() * sizeof(uint32_t) + weights.capacity() * sizeof(float) + known.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    static constexpr float kAlpha = 0.5f; // additive smoothing
+    unsigned bits;
+    size_t stride{0};             // labels per bucket row, padded to a multiple of 8
+    std::vector<uint32_t> counts; // [bucket * stride + label]
+    std::vector<float> weights;   // log(count + alpha), same layout
+    std::vector<uint32_t> known;  // examples' features in each bucket, any label
+    size_t vocabulary{0};         // buckets with known > 0
+    std::vector<std::string> names;
+    std::vector<uint64_t> docs, tokens; // per label: examples and feature occurrences
+    uint64_t totalDocs{0};
+    std::vector<float> prior, perToken; // per label: log P(label), log(tokens + alpha * vocabulary)
+
+    void grow() {
+        size_t next = (names.size() + 7) / 8 * 8;
+        std::vector<uint32_t> c(known.size() * next, 0);
+        std::vector<float> w(known.size() * next, std::log(kAlpha));
+        for (size_t b = 0; stride && b < known.size(); ++b) {
+            std::copy_n(&counts[b * stride], stride, &c[b * next]);
+            std::copy_n(&weights[b * stride], stride, &w[b * next]);
+        }
+        counts.swap(c);
+        weights.swap(w);
+        stride = next;
+    }
+
+    void count(const std::vector<uint32_t>& buckets, size_t label, int weight) {
+        // saturating at zero: a forget that does not match what was learned cannot wrap
+        auto add = [weight](auto& c, uint64_t by) {
+            using C = std::remove_reference_t<decltype(c)>;
+            if (weight >= 0) c += static_cast<C>(by);
+            else c -= static_cast<C>(std::min<uint64_t>(c, by));
+        };
+        const uint64_t w = static_cast<uint64_t>(weight < 0 ? -static_cast<int64_t>(weight) : weight);
+        for (uint32_t b: buckets) {
+            add(counts[b * stride + label], w);
+            if (known[b] == 0) ++vocabulary;
+            add(known[b], w);
+            if (known[b] == 0) --vocabulary;
+        }
+        add(tokens[label], w * buckets.size());
+        add(docs[label], w);
+        add(totalDocs, w);
+    }
+
+    void refreshCell(uint32_t b, size_t label) {
+        weights[b * stride + label] = std::log(static_cast<float>(counts[b * stride + label]) + kAlpha);
+    }
+
+    // Per-label terms; O(labels), after any change.
+    void refreshLabels() {
+        prior.assign(stride, 0);
+        perToken.assign(stride, 0);
+        double n = static_cast<double>(totalDocs) + static_cast<double>(names.size());
+        for (size_t l = 0; l < names.size(); ++l) {
+            prior[l] = static_cast<float>(std::log((static_cast<double>(docs[l]) + 1) / n));
+            perToken[l] = static_cast<float>(std::log(static_cast<double>(tokens[l]) + kAlpha * static_cast<double>(vocabulary)));
+        }
+    }
+
+    void rebuild() {
+        for (size_t i = 0; i < counts.size(); ++i) weights[i] = std::log(static_cast<float>(counts[i]) + kAlpha);
+        refreshLabels();
+    }
+
+    Prediction score(const uint32_t* buckets, size_t n, Scratch& s, const uint8_t* enabled) const {
+        Prediction out;
+        if (names.empty()) return out;
+        s.scores.assign(stride, 0.0f);
+        float* acc = s.scores.data();
+        size_t evidence = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (known[buckets[i]] == 0) continue;
+            ++evidence;
+            const float* w = &weights[buckets[i] * stride];
+            for (size_t l = 0; l < stride; ++l) acc[l] += w[l];
+        }
+        if (evidence == 0) return out;
+        float best = -INFINITY;
+        for (size_t l = 0; l < names.size(); ++l) {
+            if (enabled && !enabled[l]) continue;
+            acc[l] += prior[l] - static_cast<float>(evidence) * perToken[l];
+            if (out.label < 0 || acc[l] > best) { best = acc[l]; out.label = static_cast<int32_t>(l); }
+        }
+        if (out.label < 0) return out;
+        double sum = 0;
+        for (size_t l = 0; l < names.size(); ++l) {
+            if (enabled && !enabled[l]) continue;
+            sum += std::exp(static_cast<double>(acc[l] - best));
+        }
+        out.confidence = 1.0 / sum * static_cast<double>(evidence) / static_cast<double>(n);
+        return out;
+    }
+
+    // Feature buckets of one transaction, see the class comment.
+    void features(std::string_view merchant, std::string_view notes, std::vector<uint32_t>& cps, std::vector<uint32_t>& out) const {
+        out.clear();
+        decodeCodePoints(merchant, cps);
+        uint64_t whole = kOffset ^ 0x6d;
+        bool any = false;
+        for (uint32_t cp: cps) {
+            cp = foldCodePoint(cp);
+            if (kind(cp) == Kind::Separator || (cp >= '0' && cp <= '9')) continue;
+            whole = mix(whole, cp);
+            any = true;
+        }
+        if (any) out.push_back(bucket(whole));
+        words(cps, 0x4d, out);
+        decodeCodePoints(notes, cps);
+        words(cps, 0x4e, out);
+    }
+
+    enum class Kind { Separator, Word, Ideograph };
+
+    static Kind kind(uint32_t cp) {
+        if (cp < 0x80) return (cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z') ? Kind::Word : Kind::Separator;
+        if (cp < 0xC0 || cp == 0xD7 || cp == 0xF7) return Kind::Separator; // Latin-1 punctuation, symbols
+        if ((cp >= 0x2000 && cp <= 0x2BFF) || (cp >= 0x3000 && cp <= 0x303F) || (cp >= 0xFE30 && cp <= 0xFE4F) ||
+            (cp >= 0xFF00 && cp <= 0xFF0F)) return Kind::Separator;
+        if ((cp >= 0x2E80 && cp <= 0x2FFF) || (cp >= 0x3040 && cp <= 0x9FFF) || (cp >= 0xAC00 && cp <= 0xD7AF) ||
+            (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0x20000 && cp <= 0x2FFFF)) return Kind::Ideograph;
+        return Kind::Word;
+    }
+
+    // Words, and CJK characters and character pairs, of one field (seed keeps fields apart).
+    void words(const std::vector<uint32_t>& cps, uint64_t seed, std::vector<uint32_t>& out) const {
+        uint64_t word = kOffset ^ seed;
+        bool inWord = false, letters = false;
+        uint32_t prevIdeograph = 0;
+        auto endWord = [&] {
+            if (inWord && letters) out.push_back(bucket(word));
+            word = kOffset ^ seed;
+            inWord = letters = false;
+        };
+        for (uint32_t cp: cps) {
+            cp = foldCodePoint(cp);
+            Kind k = kind(cp);
+            if (k == Kind::Word) {
+                word = mix(word, cp);
+                inWord = true;
+                letters |= cp > '9';
+                prevIdeograph = 0;
+                continue;
+            }
+            endWord();
+            if (k == Kind::Ideograph) {
+                out.push_back(bucket(mix(kOffset ^ seed, cp)));
+                if (prevIdeograph) out.push_back(bucket(mix(mix(kOffset ^ (seed + 1), prevIdeograph), cp)));
+                prevIdeograph = cp;
+            } else {
+                prevIdeograph = 0;
+            }
+        }
+        endWord();
+    }
+
+    static constexpr uint64_t kOffset = 0xcbf29ce484222325ull; // FNV-1a
+    static uint64_t mix(uint64_t h, uint32_t cp) { return (h ^ cp) * 0x100000001b3ull; }
+    uint32_t bucket(uint64_t h) const { return static_cast<uint32_t>((h * 0x9E3779B97F4A7C15ull) >> (64 - bits)); }
+};
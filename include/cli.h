@@ -0,0 +1,199 @@
+#pragma once
+#include "csv.h"
+#include "dates.h"
+#include "decimal.h"
+#include "snapshot.h"
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// Headless subcommands for scripts and nightly jobs:
+//
+//   simple_ledger balance                     [--file F]
+//   simple_ledger report    --month YYYY-MM   [--file F]
+//   simple_ledger breakdown --year YYYY       [--file F]
+//
+// F is transactions.csv by default, or a *.snap snapshot. It is read once, front to back,
+// straight into running totals: no Transaction objects, no indexes, memory bounded by the
+// number of categories, so files larger than RAM work (the mapping is read sequentially and
+// pages already parsed are released as it goes). The journal is not replayed; point --file at a compacted file.
+// Output is a single JSON object on stdout; errors go to stderr with exit status 1 (bad file)
+// or 2 (bad usage).
+
+// Totals over the rows dated in [from, to) (epoch seconds).
+struct StreamTotals {
+    int64_t from{std::numeric_limits<int64_t>::min()};
+    int64_t to{std::numeric_limits<int64_t>::max()};
+    size_t matched{0};  // records inside the date range
+    size_t rejected{0}; // records with too few fields
+    Decimal income, expense;
+    std::map<std::string, Decimal, std::less<>> categories; // |amount| by category name
+
+    void add(int64_t epoch, Decimal amount, std::string_view category) {
+        if (epoch < from || epoch >= to) return;
+        ++matched;
+        if (amount >= Decimal()) income += amount;
+        else expense -= amount;
+        if (category.empty()) category = "Uncategorized";
+        auto it = categories.find(category);
+        if (it == categories.end()) it = categories.emplace(std::string(category), Decimal()).first;
+        it->second += amount < Decimal() ? -amount : amount;
+    }
+};
+
+// Stream a transactions.csv-layout file into totals. Rows without a readable date count as
+// dated now, like TransactionRepository::loadFromCsv does.
+static bool streamCsvTotals(const std::string& path, StreamTotals& totals) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+    const int64_t now = static_cast<int64_t>(std::time(nullptr));
+    const char* p = file.begin();
+    const char* end = file.end();
+    CsvRecord rec;
+    std::string category;
+    while (p < end) {
+        if (isBlankCsvLine(p, end)) { while (p < end && *p != '\n') ++p; if (p < end) ++p; continue; }
+        size_t n = parseCsvRecord(p, end, rec);
+        if (n < 6) { ++totals.rejected; continue; }
+        Decimal amount;
+        if (!parseCsvDecimal(rec[1], amount)) amount = Decimal();
+        long long epoch = 0;
+        if (!parseCsvInt(rec[2], epoch)) epoch = now;
+        if (rec[4].escaped) { category = rec[4].str(); totals.add(epoch, amount, category); }
+        else totals.add(epoch, amount, rec[4].raw);
+        file.release(p);
+    }
+    return true;
+}
+
+// Same over a binary snapshot, which only needs its numeric columns and category table.
+static bool streamSnapshotTotals(const std::string& path, StreamTotals& totals) {
+    SnapshotReader snap(path);
+    if (!snap.isValid()) return false;
+    std::vector<std::string_view> names(snap.categoryCount());
+    for (size_t c = 0; c < names.size(); ++c) names[c] = snap.categoryName(c);
+    const int64_t* amounts = snap.amounts();
+    const int64_t* epochs = snap.epochs();
+    const int32_t* catIds = snap.categoryIds();
+    for (size_t i = 0; i < snap.size(); ++i) {
+        Decimal amount = amounts ? Decimal::fromRaw(amounts[i]) : snap.amount(i);
+        totals.add(epochs[i], amount, catIds[i] >= 0 ? names[static_cast<size_t>(catIds[i])] : std::string_view());
+    }
+    return true;
+}
+
+static void appendJsonString(std::string& out, std::string_view s) {
+    out += '"';
+    for (char c: s) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char hex[8];
+                std::snprintf(hex, sizeof hex, "\\u%04x", static_cast<unsigned>(static_cast<unsigned char>(c)));
+                out += hex;
+            } else {
+                out += c; // UTF-8 passes through
+            }
+        }
+    }
+    out += '"';
+}
+
+// "2025-11" -> year, month
+static bool parseYearMonth(std::string_view s, int& year, int& month) {
+    long long y = 0, m = 0;
+    size_t dash = s.find('-');
+    if (dash == std::string_view::npos) return false;
+    if (!parseCsvInt(CsvField{s.substr(0, dash)}, y) || !parseCsvInt(CsvField{s.substr(dash + 1)}, m)) return false;
+    if (y < 1970 || y > 2199 || m < 1 || m > 12) return false;
+    year = static_cast<int>(y);
+    month = static_cast<int>(m);
+    return true;
+}
+
+// Run a subcommand; argv[1] is the command. Returns the process exit status.
+static int runCli(int argc, char** argv, std::ostream& out, std::ostream& err) {
+    const std::string usage = "usage: simple_ledger balance [--file F]\n"
+                              "       simple_ledger report --month YYYY-MM [--file F]\n"
+                              "       simple_ledger breakdown --year YYYY [--file F]\n";
+    std::string command = argc > 1 ? argv[1] : "";
+    std::string path = "transactions.csv", monthArg, yearArg;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) { err << usage; return 2; }
+        if (arg == "--file") path = argv[++i];
+        else if (arg == "--month" && command == "report") monthArg = argv[++i];
+        else if (arg == "--year" && command == "breakdown") yearArg = argv[++i];
+        else { err << usage; return 2; }
+    }
+
+    StreamTotals totals;
+    std::string json = "{\"command\": ";
+    appendJsonString(json, command);
+    int year = 0, month = 0;
+    if (command == "report") {
+        if (!parseYearMonth(monthArg, year, month)) { err << "report needs --month YYYY-MM\n" << usage; return 2; }
+        std::tie(totals.from, totals.to) = monthBounds(year, month);
+        json += ", \"month\": ";
+        appendJsonString(json, monthArg);
+    } else if (command == "breakdown") {
+        long long y = 0;
+        if (!parseCsvInt(CsvField{yearArg}, y) || y < 1970 || y > 2199) { err << "breakdown needs --year YYYY\n" << usage; return 2; }
+        year = static_cast<int>(y);
+        std::tie(totals.from, totals.to) = yearBounds(year);
+        json += ", \"year\": " + std::to_string(year);
+    } else if (command != "balance") {
+        err << usage;
+        return 2;
+    }
+
+    bool snapshot = path.size() >= 5 && path.compare(path.size() - 5, 5, ".snap") == 0;
+    try {
+        if (!(snapshot ? streamSnapshotTotals(path, totals) : streamCsvTotals(path, totals))) {
+            err << "cannot read " << path << '\n';
+            return 1;
+        }
+    } catch (const std::overflow_error& e) {
+        err << path << ": " << e.what() << '\n';
+        return 1;
+    }
+
+    json += ", \"file\": ";
+    appendJsonString(json, path);
+    json += ", \"transactions\": " + std::to_string(totals.matched);
+    if (totals.rejected) json += ", \"rejected\": " + std::to_string(totals.rejected);
+    json += ", \"income\": ";
+    totals.income.appendTo(json);
+    json += ", \"expense\": ";
+    totals.expense.appendTo(json);
+    json += command == "balance" ? ", \"balance\": " : ", \"net\": ";
+    (totals.income - totals.expense).appendTo(json);
+    if (command != "balance") {
+        json += ", \"categories\": {";
+        bool first = true;
+        for (auto &kv: totals.categories) {
+            if (!first) json += ", ";
+            first = false;
+            appendJsonString(json, kv.first);
+            json += ": ";
+            kv.second.appendTo(json);
+        }
+        json += '}';
+    }
+    json += "}\n";
+    out << json;
+    return 0;
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "dates.h"
+
+// Immutable, compressed storage for sealed history (see TransactionRepository::sealBefore).
+//
+// A block holds up to kMaxRows rows in date order. Per row it stores the date as a zigzag
+// varint delta from the previous row (in whole seconds when the delta is whole seconds), the
+// amount as a zigzag varint, the category slot, merchant, user and account as varint codes
+// into small per-block dictionaries, and the txnId and notes lengths. The txnId and notes
+// bytes sit back to back in one text buffer, so a decoded row views them in place and a
+// keyword search can rule a block out with one pass over its text, decoding nothing.
+// Every kGroup rows a restart point records where decoding can resume, so reading a single
+// row decodes at most kGroup - 1 others.
+//
+// The zone map (date range, income, expense, |amount| and row count per slot) tells a query
+// whether a block can matter to it without touching the rows.
+
+// One row as stored in (and read back from) a block. Strings are ids into the owner's string
+// pool; txnId and notes view the block's text when read back.
+struct ColdRow {
+    int64_t ticks{0};  // date.time_since_epoch().count()
+    int64_t amount{0}; // Decimal::raw()
+    int32_t slot{0};
+    uint32_t merchant{0}, user{0}, account{0};
+    std::string_view txnId, notes;
+
+    int64_t epoch() const { return toEpoch(std::chrono::system_clock::time_point(std::chrono::system_clock::duration(ticks))); }
+};
+
+struct ZoneMap {
+    int64_t minEpoch{0}, maxEpoch{0};
+    uint32_t rows{0};
+    int64_t income{0}, expense{0}; // Decimal::raw(); expense as a positive sum
+    struct Slot {
+        int32_t slot;
+        uint32_t rows;
+        int64_t total; // sum of |amount|
+    };
+    // Doubles as the slot dictionary: rows store an index into it. After clearCategory a slot
+    // may appear more than once.
+    std::vector<Slot> slots;
+
+    bool overlaps(int64_t from, int64_t to) const { return rows && minEpoch < to && maxEpoch >= from; }
+
+    uint32_t rowsIn(int32_t slot) const {
+        uint32_t n = 0;
+        for (auto &s: slots) if (s.slot == slot) n += s.rows;
+        return n;
+    }
+    int64_t totalIn(int32_t slot) const {
+        int64_t n = 0;
+        for (auto &s: slots) if (s.slot == slot) n += s.total;
+        return n;
+    }
+};
+
+class ColdBlock {
+public:
+    static constexpr size_t kMaxRows = 4096;
+    static constexpr size_t kGroup = 32;
+
+    // Encode rows (ascending epoch) that will be numbered firstRow, firstRow + 1, ...
+    ColdBlock(const ColdRow* rows, size_t n, uint32_t firstRow): first(firstRow) {
+        std::unordered_map<int32_t, uint32_t> slotCodes;
+        std::unordered_map<uint32_t, uint32_t> stringCodes;
+        auto stringCode = [&](uint32_t id) {
+            auto it = stringCodes.emplace(id, static_cast<uint32_t>(strings.size()));
+            if (it.second) strings.push_back(id);
+            return it.first->second;
+        };
+        size_t textBytes = 0;
+        for (size_t i = 0; i < n; ++i) textBytes += rows[i].txnId.size() + rows[i].notes.size();
+        text.reserve(textBytes);
+        int64_t prev = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const ColdRow& r = rows[i];
+            int64_t epoch = r.epoch();
+            if (i % kGroup == 0) restarts.push_back({static_cast<uint32_t>(data.size()), static_cast<uint32_t>(text.size()), prev, epoch});
+            int64_t delta = r.ticks - prev;
+            if (delta % kTicksPerSecond == 0) putVarint(zigzag(delta / kTicksPerSecond) << 1);
+            else putVarint(zigzag(delta) << 1 | 1);
+            prev = r.ticks;
+            putVarint(zigzag(r.amount));
+            auto slot = slotCodes.emplace(r.slot, static_cast<uint32_t>(zone.slots.size()));
+            if (slot.second) zone.slots.push_back({r.slot, 0, 0});
+            putVarint(slot.first->second);
+            putVarint(stringCode(r.merchant));
+            putVarint(stringCode(r.user));
+            putVarint(stringCode(r.account));
+            putVarint(r.txnId.size());
+            putVarint(r.notes.size());
+            text.insert(text.end(), r.txnId.begin(), r.txnId.end());
+            text.insert(text.end(), r.notes.begin(), r.notes.end());
+
+            int64_t abs = r.amount >= 0 ? r.amount : -r.amount;
+            if (zone.rows == 0) zone.minEpoch = epoch;
+            zone.maxEpoch = epoch;
+            ++zone.rows;
+            (r.amount >= 0 ? zone.income : zone.expense) += abs;
+            auto &s = zone.slots[slot.first->second];
+            ++s.rows;
+            s.total += abs;
+        }
+        data.shrink_to_fit();
+        restarts.shrink_to_fit();
+        strings.shrink_to_fit();
+        zone.slots.shrink_to_fit();
+    }
+
+    const ZoneMap& zoneMap() const { return zone; }
+    uint32_t firstRow() const { return first; }
+    size_t size() const { return zone.rows; }
+
+    ColdRow row(size_t i) const {
+        ColdRow out;
+        Cursor c = at(i / kGroup);
+        for (size_t k = i - i % kGroup; k <= i; ++k) next(c, out);
+        return out;
+    }
+
+    // f(row number, ColdRow) for every row, in order.
+    template <class F>
+    void forEach(F&& f) const {
+        ColdRow r;
+        Cursor c = at(0);
+        for (size_t i = 0; i < zone.rows; ++i) {
+            next(c, r);
+            f(first + static_cast<uint32_t>(i), r);
+        }
+    }
+
+    // The same for the rows dated in [from, to); starts at the nearest restart point.
+    template <class F>
+    void forEachIn(int64_t from, int64_t to, F&& f) const {
+        if (!zone.overlaps(from, to)) return;
+        auto it = std::lower_bound(restarts.begin(), restarts.end(), from, [](const Restart& r, int64_t e) { return r.epoch < e; });
+        size_t g = it == restarts.begin() ? 0 : static_cast<size_t>(it - restarts.begin()) - 1;
+        ColdRow r;
+        Cursor c = at(g);
+        for (size_t i = g * kGroup; i < zone.rows; ++i) {
+            next(c, r);
+            int64_t epoch = r.epoch();
+            if (epoch >= to) break;
+            if (epoch >= from) f(first + static_cast<uint32_t>(i), r);
+        }
+    }
+
+    // False when no txnId or notes in the block contain s (merchants are checked separately,
+    // through stringIds()).
+    bool textContains(std::string_view s) const { return std::string_view(text.data(), text.size()).find(s) != std::string_view::npos; }
+
+    // The string ids (merchant, user, account) the block refers to.
+    const std::vector<uint32_t>& stringIds() const { return strings; }
+
+    // Rows of `slot` now count as uncategorized (slot 0): a dictionary rewrite, the rows stay put.
+    void clearSlot(int32_t slot) {
+        for (auto &s: zone.slots) if (s.slot == slot) s.slot = 0;
+    }
+
+    size_t bytesReserved() const {
+        return data.capacity() + text.capacity() + restarts.capacity() * sizeof(Restart) +
+               strings.capacity() * sizeof(uint32_t) + zone.slots.capacity() * sizeof(ZoneMap::Slot);
+    }
+
+private:
+    static constexpr int64_t kTicksPerSecond = std::chrono::system_clock::duration(std::chrono::seconds(1)).count();
+
+    struct Restart {
+        uint32_t data, text; // offsets of the group's first row
+        int64_t ticks;       // date of the row before it (0 for the first group)
+        int64_t epoch;       // epoch of the group's first row
+    };
+    struct Cursor {
+        const uint8_t* p;
+        size_t text;
+        int64_t ticks;
+    };
+
+    uint32_t first;
+    ZoneMap zone;
+    std::vector<uint8_t> data;
+    std::vector<char> text;
+    std::vector<Restart> restarts;
+    std::vector<uint32_t> strings; // dictionary: code -> string id
+
+    static uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+    static int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+    void putVarint(uint64_t v) {
+        while (v >= 0x80) {
+            data.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        data.push_back(static_cast<uint8_t>(v));
+    }
+
+    static uint64_t getVarint(const uint8_t*& p) {
+        uint64_t v = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t b = *p++;
+            v |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (b < 0x80) return v;
+        }
+    }
+
+    Cursor at(size_t group) const {
+        if (group >= restarts.size()) return {data.data(), 0, 0};
+        const Restart& r = restarts[group];
+        return {data.data() + r.data, r.text, r.ticks};
+    }
+
+    void next(Cursor& c, ColdRow& out) const {
+        uint64_t d = getVarint(c.p);
+        c.ticks += d & 1 ? unzigzag(d >> 1) : unzigzag(d >> 1) * kTicksPerSecond;
+        out.ticks = c.ticks;
+        out.amount = unzigzag(getVarint(c.p));
+        out.slot = zone.slots[getVarint(c.p)].slot;
+        out.merchant = strings[getVarint(c.p)];
+        out.user = strings[getVarint(c.p)];
+        out.account = strings[getVarint(c.p)];
+        size_t idLen = getVarint(c.p), notesLen = getVarint(c.p);
+        out.txnId = std::string_view(text.data() + c.text, idLen);
+        out.notes = std::string_view(text.data() + c.text + idLen, notesLen);
+        c.text += idLen + notesLen;
+    }
+};
@@ -0,0 +1,166 @@
+#pragma once
+#include "repositories.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Transaction store for reading while importing: many readers, one writer at a time, and
+// snapshot isolation between them.
+//
+// The rows live in immutable segments, each a settled TransactionRepository (so its const
+// queries modify nothing). A version is the list of segments at one point in time. A write
+// builds its segment off to the side and publishes a new version with a single atomic pointer
+// store; a reader takes the current version with a single atomic load. A report therefore sees
+// one consistent set of rows however long it runs, and neither side ever waits for the other.
+// Versions and segments are reference counted, so memory is reclaimed when the last snapshot
+// still using it is dropped (RCU-style, with shared_ptr doing the epoch bookkeeping).
+//
+// Segments merge like a binary counter: new rows absorb the newest segment while it is no
+// larger than they are, so there are O(log n) segments and each row is copied O(log n) times.
+
+class StoreSnapshot {
+public:
+    StoreSnapshot() = default;
+
+    uint64_t version() const { return v ? v->number : 0; }
+    size_t size() const { return v ? v->rows : 0; }
+    size_t segmentCount() const { return v ? v->segments.size() : 0; }
+
+    // f(const TransactionRepository&) for every segment, oldest first; per-repository code
+    // (e.g. ReportService) can run on each and merge, since Decimal sums are exact.
+    template <class F>
+    void forEachSegment(F&& f) const {
+        if (v) for (auto &s: v->segments) f(static_cast<const TransactionRepository&>(*s));
+    }
+
+    // Every transaction, in insertion order.
+    template <class F>
+    void forEach(F&& f) const {
+        forEachSegment([&](const TransactionRepository& s) { s.forEach(f); });
+    }
+
+    Decimal balance() const {
+        Decimal total;
+        forEachSegment([&](const TransactionRepository& s) { total += s.balance(); });
+        return total;
+    }
+
+    TransactionRepository::IncomeExpense incomeExpense(int firstKey, int endKey) const {
+        TransactionRepository::IncomeExpense out;
+        forEachSegment([&](const TransactionRepository& s) {
+            auto part = s.incomeExpense(firstKey, endKey);
+            out.income += part.income;
+            out.expense += part.expense;
+        });
+        return out;
+    }
+
+    std::map<std::string, Decimal> categoryTotals(int firstKey, int endKey) const {
+        std::map<std::string, Decimal> out;
+        forEachSegment([&](const TransactionRepository& s) {
+            for (auto &kv: s.categoryTotals(firstKey, endKey)) out[kv.first] += kv.second;
+        });
+        return out;
+    }
+
+    TransactionRepository::IncomeExpense incomeExpenseBetween(int64_t from, int64_t to) const {
+        TransactionRepository::IncomeExpense out;
+        forEachSegment([&](const TransactionRepository& s) {
+            auto part = s.incomeExpenseBetween(from, to);
+            out.income += part.income;
+            out.expense += part.expense;
+        });
+        return out;
+    }
+
+    std::map<std::string, Decimal> categoryTotalsBetween(int64_t from, int64_t to) const {
+        std::map<std::string, Decimal> out;
+        forEachSegment([&](const TransactionRepository& s) {
+            for (auto &kv: s.categoryTotalsBetween(from, to)) out[kv.first] += kv.second;
+        });
+        return out;
+    }
+
+    std::map<std::string, Decimal> categoryTotalsAll() const {
+        return categoryTotals(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    }
+
+    // Copies rather than views: callers may keep them after dropping the snapshot.
+    std::vector<Transaction> findByUserAndMonth(const std::string& userId, int year, int month) const {
+        std::vector<Transaction> out;
+        forEachSegment([&](const TransactionRepository& s) {
+            size_t sorted = out.size();
+            for (const auto &t: s.findByUserAndMonth(userId, year, month)) out.push_back(t);
+            // each segment is in date order; merge it into what came before
+            std::inplace_merge(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(sorted), out.end(),
+                               [](const Transaction& a, const Transaction& b) { return a.date < b.date; });
+        });
+        return out;
+    }
+
+    std::vector<Transaction> searchByKeyword(const std::string& kw) const {
+        std::vector<Transaction> out;
+        forEachSegment([&](const TransactionRepository& s) {
+            for (const auto &t: s.searchByKeyword(kw)) out.push_back(t);
+        });
+        return out;
+    }
+
+private:
+    friend class ConcurrentTransactionStore;
+    struct Version {
+        uint64_t number{0};
+        size_t rows{0};
+        std::vector<std::shared_ptr<const TransactionRepository>> segments;
+    };
+    std::shared_ptr<const Version> v;
+
+    explicit StoreSnapshot(std::shared_ptr<const Version> version): v(std::move(version)) {}
+};
+
+class ConcurrentTransactionStore {
+public:
+    ConcurrentTransactionStore(): current(std::make_shared<const Version>()) {}
+
+    // The latest published version. Never blocks.
+    StoreSnapshot snapshot() const { return StoreSnapshot(std::atomic_load(&current)); }
+
+    void save(const Transaction& t) { saveBatch(std::vector<Transaction>{t}); }
+
+    // Append rows in order and publish them as one new version. Writers are serialized among
+    // themselves; readers are unaffected.
+    void saveBatch(std::vector<Transaction>&& rows) {
+        if (rows.empty()) return;
+        std::lock_guard<std::mutex> lk(writeMutex);
+        auto next = std::make_shared<Version>(*std::atomic_load(&current));
+        next->rows += rows.size();
+        while (!next->segments.empty() && next->segments.back()->size() <= rows.size()) {
+            // the segment stays intact for readers of older versions; copy its rows
+            std::vector<Transaction> merged;
+            merged.reserve(next->segments.back()->size() + rows.size());
+            next->segments.back()->forEach([&](const TxnRef& t) { merged.push_back(t); });
+            for (auto &t: rows) merged.push_back(std::move(t));
+            rows.swap(merged);
+            next->segments.pop_back();
+        }
+        auto segment = std::make_shared<TransactionRepository>();
+        segment->loadRows(std::move(rows));
+        segment->settle();
+        next->segments.push_back(std::move(segment));
+        ++next->number;
+        std::atomic_store(&current, std::shared_ptr<const Version>(std::move(next)));
+    }
+
+    // Import interface (see import_pipeline.h); segments are sized by their batches, so there
+    // is nothing to reserve.
+    void reserve(size_t) {}
+
+private:
+    using Version = StoreSnapshot::Version;
+    std::shared_ptr<const Version> current; // only accessed through std::atomic_load/store
+    std::mutex writeMutex;
+};
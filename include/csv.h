@@ -0,0 +1,318 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <charconv>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <cmath>
+#include "decimal.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// small CSV helpers used by both CategoryRepository and TransactionRepository
+inline std::string escapeCsv(std::string_view s) {
+    std::string out;
+    for (char c: s) {
+        if (c == '"') out += "\"\""; // double the quote
+        else out += c;
+    }
+    return out;
+}
+
+// Read-only memory mapping of a whole file. An empty or missing file maps to an empty range.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        opened = true;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz) || sz.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return;
+        void* p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!p) return;
+        ptr = static_cast<const char*>(p);
+        len = static_cast<size_t>(sz.QuadPart);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        opened = true;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0) return;
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) return;
+        ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+        ptr = static_cast<const char*>(p);
+        len = static_cast<size_t>(st.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (ptr) ::munmap(const_cast<char*>(ptr), len);
+        if (fd >= 0) ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + len; }
+
+    // Hint that [begin(), upTo) will not be read again, so a single pass over a file larger
+    // than RAM keeps a small resident set. The range stays readable (pages fault back in).
+    void release(const char* upTo) {
+        size_t done = static_cast<size_t>(upTo - ptr) & ~static_cast<size_t>(0xFFFFF); // whole MiB
+        if (done <= released) return;
+#ifdef _WIN32
+        VirtualUnlock(const_cast<char*>(ptr) + released, done - released);
+#else
+        ::madvise(const_cast<char*>(ptr) + released, done - released, MADV_DONTNEED);
+#endif
+        released = done;
+    }
+
+private:
+    const char* ptr{nullptr};
+    size_t released{0};
+    size_t len{0};
+    bool opened{false};
+#ifdef _WIN32
+    HANDLE file{INVALID_HANDLE_VALUE};
+    HANDLE mapping{nullptr};
+#else
+    int fd{-1};
+#endif
+};
+
+// Flush stdio buffers and force the file contents to stable storage.
+inline bool syncFile(FILE* f) {
+    if (std::fflush(f) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return ::fsync(fileno(f)) == 0;
+#endif
+}
+
+// One field of a CSV record, pointing into the source buffer. Quotes are already stripped;
+// `escaped` is set when the field contains doubled quotes that str() has to collapse.
+struct CsvField {
+    std::string_view raw;
+    bool escaped{false};
+
+    std::string str() const {
+        if (!escaped) return std::string(raw);
+        std::string out;
+        out.reserve(raw.size());
+        for (size_t i = 0; i < raw.size(); ++i) {
+            out += raw[i];
+            if (raw[i] == '"' && i + 1 < raw.size() && raw[i+1] == '"') ++i;
+        }
+        return out;
+    }
+};
+
+constexpr size_t kMaxCsvFields = 16;
+using CsvRecord = std::array<CsvField, kMaxCsvFields>;
+
+// Parse one record starting at p and advance p past its line terminator. Quoted fields may
+// contain commas, doubled quotes and newlines. Returns the number of fields seen; fields past
+// kMaxCsvFields are skipped.
+inline size_t parseCsvRecord(const char*& p, const char* end, CsvRecord& fields) {
+    size_t n = 0;
+    while (p < end) {
+        CsvField f;
+        if (*p == '"') {
+            const char* start = ++p;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') { f.escaped = true; p += 2; continue; }
+                    break;
+                }
+                ++p;
+            }
+            f.raw = std::string_view(start, static_cast<size_t>(p - start));
+            if (p < end) ++p; // closing quote
+            while (p < end && *p != ',' && *p != '\n') ++p; // tolerate junk after the quote
+        } else {
+            const char* start = p;
+            while (p < end && *p != ',' && *p != '\n') ++p;
+            const char* stop = p;
+            if (stop > start && stop[-1] == '\r') --stop;
+            f.raw = std::string_view(start, static_cast<size_t>(stop - start));
+        }
+        if (n < kMaxCsvFields) fields[n] = f;
+        ++n;
+        if (p >= end) break;
+        if (*p == '\n') { ++p; break; }
+        ++p; // comma
+        if (p >= end || *p == '\n' || *p == '\r') {
+            // trailing comma: one more empty field
+            if (n < kMaxCsvFields) fields[n] = CsvField{};
+            ++n;
+            while (p < end && *p != '\n') ++p;
+            if (p < end) ++p;
+            break;
+        }
+    }
+    return n < kMaxCsvFields ? n : kMaxCsvFields;
+}
+
+inline bool isBlankCsvLine(const char* p, const char* end) {
+    return p < end && (*p == '\n' || (*p == '\r' && (p + 1 == end || p[1] == '\n')));
+}
+
+// Numeric fields are parsed in place; on failure `out` is left untouched and false is returned.
+template <class T>
+inline bool parseCsvInt(const CsvField& f, T& out) {
+    T v{};
+    auto r = std::from_chars(f.raw.data(), f.raw.data() + f.raw.size(), v);
+    if (r.ec != std::errc()) return false;
+    out = v;
+    return true;
+}
+
+inline bool parseCsvDouble(const CsvField& f, double& out) {
+    double v = 0;
+    const char* b = f.raw.data();
+    const char* e = b + f.raw.size();
+    if (b < e && *b == '+') ++b; // from_chars rejects a leading plus
+    auto r = std::from_chars(b, e, v);
+    if (r.ec != std::errc()) return false;
+    out = v;
+    return true;
+}
+
+// Money column: exact decimal text, or (as older files may hold) any double within range.
+inline bool parseCsvDecimal(const CsvField& f, Decimal& out) {
+    if (Decimal::parse(f.raw, out)) return true;
+    double v = 0;
+    if (!parseCsvDouble(f, v) || !(std::fabs(v) < 9.2e14)) return false;
+    out = Decimal(v);
+    return true;
+}
+
+// Split [begin, end) into up to `parts` ranges that each start at the beginning of a record.
+// Every part counts its quotes in parallel so we know whether its raw start lies inside a quoted
+// field; the start is then moved to the first newline outside quotes. Doubled quotes keep the
+// parity even, so they need no special handling. A stray quote inside an unquoted field (which
+// parseCsvRecord keeps as text) throws the parity off, so a bound may land mid-record; the
+// parse below detects that and starts over serially.
+inline std::vector<const char*> splitCsvChunks(const char* begin, const char* end, size_t parts) {
+    std::vector<const char*> bounds{begin};
+    size_t total = static_cast<size_t>(end - begin);
+    if (parts < 2 || total == 0) { bounds.push_back(end); return bounds; }
+
+    std::vector<const char*> raw(parts + 1);
+    for (size_t i = 0; i <= parts; ++i) raw[i] = begin + total * i / parts;
+    std::vector<size_t> quotes(parts, 0);
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < parts; ++i) {
+            workers.emplace_back([&, i] {
+                size_t q = 0;
+                for (const char* p = raw[i]; p < raw[i+1]; ++p) q += (*p == '"');
+                quotes[i] = q;
+            });
+        }
+        for (auto& w: workers) w.join();
+    }
+    size_t seen = 0;
+    for (size_t i = 1; i < parts; ++i) {
+        seen += quotes[i-1];
+        bool inQuote = (seen & 1) != 0;
+        const char* p = raw[i];
+        // raw[i] may sit right after a newline: that is already a record start
+        if (!inQuote && p[-1] == '\n') { bounds.push_back(p); continue; }
+        for (; p < end; ++p) {
+            if (*p == '"') inQuote = !inQuote;
+            else if (*p == '\n' && !inQuote) { ++p; break; }
+        }
+        if (p > bounds.back()) bounds.push_back(p);
+    }
+    if (bounds.back() != end) bounds.push_back(end);
+    return bounds;
+}
+
+// Parse every record of [begin, end) into Row values, fanning chunks out to worker threads
+// (`parts` of them at most; 0 = one per core). parseRow(const CsvRecord&, size_t fieldCount,
+// Row&) returns false to drop a record. Rows come back in file order.
+template <class Row, class ParseRow>
+inline std::vector<Row> parseCsvParallel(const char* begin, const char* end, ParseRow parseRow,
+                                         size_t minChunkBytes = 1 << 20, size_t parts = 0) {
+    std::vector<Row> out;
+    if (begin == end) return out;
+    if (parts == 0) parts = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t bytes = static_cast<size_t>(end - begin);
+    parts = std::min(parts, bytes / std::max<size_t>(minChunkBytes, 1) + 1);
+    auto bounds = splitCsvChunks(begin, end, parts);
+    size_t chunks = bounds.size() - 1;
+
+    // Records starting in [b, e), read up to the end of the input. Returns where the last one
+    // ended: e exactly when e is a record start, given that b is one.
+    auto parseChunk = [&](const char* b, const char* e, std::vector<Row>& rows) {
+        CsvRecord fields;
+        const char* p = b;
+        while (p < e) {
+            if (isBlankCsvLine(p, end)) { while (p < end && *p != '\n') ++p; if (p < end) ++p; continue; }
+            size_t n = parseCsvRecord(p, end, fields);
+            Row r;
+            if (parseRow(fields, n, r)) rows.push_back(std::move(r));
+        }
+        return p;
+    };
+
+    if (chunks == 1) { parseChunk(bounds[0], bounds[1], out); return out; }
+
+    std::vector<std::vector<Row>> partial(chunks);
+    std::vector<const char*> stops(chunks);
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < chunks; ++i) {
+        workers.emplace_back([&, i] { stops[i] = parseChunk(bounds[i], bounds[i+1], partial[i]); });
+    }
+    for (auto& w: workers) w.join();
+    // a chunk that ran past its bound started (or made the next one start) mid-record
+    for (size_t i = 0; i < chunks; ++i) {
+        if (stops[i] != bounds[i+1]) { parseChunk(begin, end, out); return out; }
+    }
+    size_t n = 0;
+    for (auto& v: partial) n += v.size();
+    out.reserve(n);
+    for (auto& v: partial) {
+        for (auto& r: v) out.push_back(std::move(r));
+        std::vector<Row>().swap(v);
+    }
+    return out;
+}
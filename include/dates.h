@@ -0,0 +1,102 @@
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Calendar helpers that avoid calling localtime_r / localtime_s per transaction.
+//
+// A month is identified by a key: year * 12 + (month - 1). The local start of every month
+// from 1970 to 2199 is computed once with mktime (so DST and historic offset changes are
+// honoured) and kept in a sorted table; mapping an epoch to its month is a binary search in
+// that table, and a month or year query becomes a pair of table lookups.
+
+inline int monthKey(int year, int month) { return year * 12 + (month - 1); }
+inline int keyYear(int key) { return key >= 0 ? key / 12 : -((-key + 11) / 12); }
+inline int keyMonth(int key) { return key - keyYear(key) * 12 + 1; }
+
+// Local midnight of the first day of the month, via mktime (normalizes out-of-range months).
+inline int64_t mktimeMonthStart(int year, int month) {
+    tm local{};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = 1;
+    local.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&local));
+}
+
+class MonthTable {
+public:
+    static const MonthTable& instance() {
+        static const MonthTable table;
+        return table;
+    }
+
+    // Epoch second at which the month with this key starts (local time).
+    int64_t start(int key) const {
+        if (key >= firstKey && key < firstKey + static_cast<int>(starts.size())) return starts[static_cast<size_t>(key - firstKey)];
+        return mktimeMonthStart(keyYear(key), keyMonth(key));
+    }
+
+    // Month key containing the given epoch second (local time).
+    int keyOf(int64_t epoch) const {
+        if (starts.empty() || epoch < starts.front() || epoch >= starts.back()) {
+            std::time_t tt = static_cast<std::time_t>(epoch);
+            tm local{};
+#ifdef _WIN32
+            localtime_s(&local, &tt);
+#else
+            localtime_r(&tt, &local);
+#endif
+            return monthKey(local.tm_year + 1900, local.tm_mon + 1);
+        }
+        auto it = std::upper_bound(starts.begin(), starts.end(), epoch);
+        return firstKey + static_cast<int>(it - starts.begin()) - 1;
+    }
+
+private:
+    static constexpr int kFirstYear = 1970, kLastYear = 2199;
+    int firstKey{monthKey(kFirstYear, 1)};
+    std::vector<int64_t> starts;
+
+    MonthTable() {
+        // the first entry is usually before the epoch in zones east of UTC; mktime may refuse it
+        if (mktimeMonthStart(kFirstYear, 1) < 0) firstKey = monthKey(kFirstYear, 2);
+        for (int key = firstKey; key <= monthKey(kLastYear, 12) + 1; ++key) starts.push_back(mktimeMonthStart(keyYear(key), keyMonth(key)));
+    }
+};
+
+inline int64_t toEpoch(std::chrono::system_clock::time_point tp) {
+    return static_cast<int64_t>(std::chrono::system_clock::to_time_t(tp));
+}
+
+inline int monthKeyOf(std::chrono::system_clock::time_point tp) { return MonthTable::instance().keyOf(toEpoch(tp)); }
+
+// Local [from, to) epoch bounds of a calendar month and of a calendar year.
+inline std::pair<int64_t, int64_t> monthBounds(int year, int month) {
+    auto& table = MonthTable::instance();
+    int key = monthKey(year, month);
+    return {table.start(key), table.start(key + 1)};
+}
+
+// Local midnight starting the day that contains `epoch`, moved by `days` calendar days
+// (mktime normalizes, so this is DST-safe).
+inline int64_t localDayStart(int64_t epoch, int days = 0) {
+    std::time_t tt = static_cast<std::time_t>(epoch);
+    tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &tt);
+#else
+    localtime_r(&tt, &local);
+#endif
+    local.tm_mday += days;
+    local.tm_hour = local.tm_min = local.tm_sec = 0;
+    local.tm_isdst = -1;
+    return static_cast<int64_t>(std::mktime(&local));
+}
+
+inline std::pair<int64_t, int64_t> yearBounds(int year) {
+    auto& table = MonthTable::instance();
+    return {table.start(monthKey(year, 1)), table.start(monthKey(year + 1, 1))};
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Money as a signed 64-bit count of 1/10000 units (four decimal places, roughly +/-9.2e14).
+//
+// Integer sums are exact and associative, so totals do not depend on summation order: a
+// parallel or vectorized reduction over raw() values gives the same bits as a serial loop.
+// Arithmetic between Decimals throws std::overflow_error instead of wrapping.
+//
+// Conversions to and from double are implicit so existing code that does `Decimal d = 1.5;`
+// or `double x = d;` keeps compiling; a double is rounded to the nearest unit on the way in.
+class Decimal {
+public:
+    static constexpr int kScale = 4;
+    static constexpr int64_t kUnit = 10000;
+
+    constexpr Decimal() = default;
+
+    Decimal(double v) {
+        double scaled = std::round(v * kUnit);
+        // 2^63 is exactly representable; anything at or beyond it (or NaN) does not fit
+        if (!(scaled > -9223372036854775808.0 && scaled < 9223372036854775808.0)) throw std::overflow_error("Decimal: value out of range");
+        units = static_cast<int64_t>(scaled);
+    }
+
+    template <class I, typename std::enable_if<std::is_integral<I>::value, int>::type = 0>
+    Decimal(I v) {
+        if (std::is_signed<I>::value ? !fits(static_cast<long long>(v)) : static_cast<unsigned long long>(v) > static_cast<unsigned long long>(kMaxWhole))
+            throw std::overflow_error("Decimal: value out of range");
+        units = static_cast<int64_t>(v) * kUnit;
+    }
+
+    static constexpr Decimal fromRaw(int64_t units) { Decimal d; d.units = units; return d; }
+    constexpr int64_t raw() const { return units; }
+
+    operator double() const { return static_cast<double>(units) / kUnit; }
+
+    Decimal operator-() const {
+        if (units == std::numeric_limits<int64_t>::min()) throw std::overflow_error("Decimal: negation overflow");
+        return fromRaw(-units);
+    }
+    Decimal& operator+=(Decimal o) { units = checkedAdd(units, o.units); return *this; }
+    Decimal& operator-=(Decimal o) { units = checkedSub(units, o.units); return *this; }
+
+    friend Decimal operator+(Decimal a, Decimal b) { return a += b; }
+    friend Decimal operator-(Decimal a, Decimal b) { return a -= b; }
+    template <class I, typename std::enable_if<std::is_integral<I>::value, int>::type = 0>
+    friend Decimal operator*(Decimal a, I n) { return fromRaw(checkedMul(a.units, static_cast<int64_t>(n))); }
+    template <class I, typename std::enable_if<std::is_integral<I>::value, int>::type = 0>
+    friend Decimal operator*(I n, Decimal a) { return a * n; }
+
+    friend bool operator==(Decimal a, Decimal b) { return a.units == b.units; }
+    friend bool operator!=(Decimal a, Decimal b) { return a.units != b.units; }
+    friend bool operator<(Decimal a, Decimal b) { return a.units < b.units; }
+    friend bool operator<=(Decimal a, Decimal b) { return a.units <= b.units; }
+    friend bool operator>(Decimal a, Decimal b) { return a.units > b.units; }
+    friend bool operator>=(Decimal a, Decimal b) { return a.units >= b.units; }
+
+    // Mixed with plain numbers: +/- convert the number, comparisons go through double (so
+    // `d == 100.5` means what it says and a number that does not fit never throws).
+#define LEDGER_DECIMAL_MIXED(op, conv)                                                                  \
+    template <class T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>           \
+    friend auto operator op(Decimal a, T b) { return conv(a) op conv(b); }                              \
+    template <class T, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>           \
+    friend auto operator op(T a, Decimal b) { return conv(a) op conv(b); }
+    LEDGER_DECIMAL_MIXED(+, Decimal)
+    LEDGER_DECIMAL_MIXED(-, Decimal)
+    LEDGER_DECIMAL_MIXED(==, static_cast<double>)
+    LEDGER_DECIMAL_MIXED(!=, static_cast<double>)
+    LEDGER_DECIMAL_MIXED(<, static_cast<double>)
+    LEDGER_DECIMAL_MIXED(<=, static_cast<double>)
+    LEDGER_DECIMAL_MIXED(>, static_cast<double>)
+    LEDGER_DECIMAL_MIXED(>=, static_cast<double>)
+#undef LEDGER_DECIMAL_MIXED
+
+    // Exact decimal text: "-12.5", "3", "0.0001".
+    void appendTo(std::string& out) const {
+        uint64_t mag = units < 0 ? 0 - static_cast<uint64_t>(units) : static_cast<uint64_t>(units);
+        if (units < 0) out += '-';
+        out += std::to_string(mag / kUnit);
+        uint64_t frac = mag % kUnit;
+        if (frac == 0) return;
+        char digits[kScale];
+        int len = kScale;
+        for (int i = kScale - 1; i >= 0; --i) { digits[i] = static_cast<char>('0' + frac % 10); frac /= 10; }
+        while (digits[len - 1] == '0') --len;
+        out += '.';
+        out.append(digits, static_cast<size_t>(len));
+    }
+
+    std::string toString() const { std::string s; appendTo(s); return s; }
+
+    // Parse "[+-]digits[.digits]" exactly; digits past the fourth decimal round half away
+    // from zero. Anything else (exponents, junk) returns false.
+    static bool parse(std::string_view s, Decimal& out) {
+        size_t i = 0;
+        bool neg = false;
+        if (i < s.size() && (s[i] == '-' || s[i] == '+')) neg = s[i++] == '-';
+        uint64_t whole = 0;
+        size_t start = i;
+        for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+            whole = whole * 10 + static_cast<uint64_t>(s[i] - '0');
+            if (whole > static_cast<uint64_t>(kMaxWhole) + 1) return false;
+        }
+        bool any = i > start;
+        uint64_t frac = 0;
+        int fracDigits = 0;
+        bool roundUp = false;
+        if (i < s.size() && s[i] == '.') {
+            ++i;
+            size_t fstart = i;
+            for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+                if (fracDigits < kScale) { frac = frac * 10 + static_cast<uint64_t>(s[i] - '0'); ++fracDigits; }
+                else if (fracDigits++ == kScale) roundUp = s[i] >= '5';
+            }
+            any = any || i > fstart;
+        }
+        if (!any || i != s.size()) return false;
+        for (int k = std::min(fracDigits, kScale); k < kScale; ++k) frac *= 10;
+        uint64_t mag = whole * static_cast<uint64_t>(kUnit) + frac + (roundUp ? 1 : 0);
+        uint64_t limit = neg ? static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + 1 : static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+        if (mag > limit) return false;
+        out.units = neg ? static_cast<int64_t>(0 - mag) : static_cast<int64_t>(mag);
+        return true;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, Decimal d) {
+        // honour std::fixed/setprecision; otherwise print every significant digit
+        if (os.flags() & std::ios::fixed) return os << static_cast<double>(d);
+        return os << d.toString();
+    }
+
+private:
+    static constexpr int64_t kMaxWhole = std::numeric_limits<int64_t>::max() / kUnit;
+    int64_t units{0};
+
+    static bool fits(long long v) { return v >= -kMaxWhole && v <= kMaxWhole; }
+
+    static int64_t checkedAdd(int64_t a, int64_t b) {
+        int64_t r;
+#if defined(__GNUC__) || defined(__clang__)
+        if (__builtin_add_overflow(a, b, &r)) throw std::overflow_error("Decimal: addition overflow");
+#else
+        if ((b > 0 && a > std::numeric_limits<int64_t>::max() - b) || (b < 0 && a < std::numeric_limits<int64_t>::min() - b))
+            throw std::overflow_error("Decimal: addition overflow");
+        r = a + b;
+#endif
+        return r;
+    }
+
+    static int64_t checkedSub(int64_t a, int64_t b) {
+        int64_t r;
+#if defined(__GNUC__) || defined(__clang__)
+        if (__builtin_sub_overflow(a, b, &r)) throw std::overflow_error("Decimal: subtraction overflow");
+#else
+        if ((b < 0 && a > std::numeric_limits<int64_t>::max() + b) || (b > 0 && a < std::numeric_limits<int64_t>::min() + b))
+            throw std::overflow_error("Decimal: subtraction overflow");
+        r = a - b;
+#endif
+        return r;
+    }
+
+    static int64_t checkedMul(int64_t a, int64_t b) {
+        int64_t r;
+#if defined(__GNUC__) || defined(__clang__)
+        if (__builtin_mul_overflow(a, b, &r)) throw std::overflow_error("Decimal: multiplication overflow");
+#else
+        if (a != 0 && (b > std::numeric_limits<int64_t>::max() / (a < 0 ? -a : a) || b < -(std::numeric_limits<int64_t>::max() / (a < 0 ? -a : a))))
+            throw std::overflow_error("Decimal: multiplication overflow");
+        r = a * b;
+#endif
+        return r;
+    }
+};
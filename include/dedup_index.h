@@ -0,0 +1,147 @@
+#pragma once
+#include "matcher.h"
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+// Duplicate detection for imports (TransactionRepository::findDuplicate).
+//
+// A transaction's dedup key hashes its amount, its merchant with case, spaces and punctuation
+// folded away ("WALMART #12" and "Walmart 12" agree), its txnId when it has one, and its day
+// (epoch / 86400). A lookup that tolerates dates w seconds apart probes the keys of every day
+// in [epoch - w, epoch + w], so it costs 1 + 2 * ceil(w / 86400) probes at most (3 for any
+// window up to a day) however many rows the repository holds. Hits are verified against the
+// stored row, so hash collisions cost a look at the row, never a wrong answer.
+//
+// Keys sit in an open-addressing table (linear probing, power-of-two capacity, at most 3/4
+// full), key and row number in parallel arrays. A key may be present more than once (the same
+// purchase twice in a day); lookups walk all of them. In front of the table is a blocked Bloom
+// filter with one 64-byte block per key: rows that are not duplicates, nearly all of them,
+// usually stop after that one cache line, which stays cached far more often than the table.
+// Entries are never removed; growing rebuilds both from the stored keys.
+
+static constexpr int64_t kDedupDay = 86400;
+
+// What a bulk save does with a row that repeats a stored one.
+enum class DuplicatePolicy {
+    Allow,  // no check, save everything
+    Reject, // drop it
+    Flag,   // save it, but report it with the row it repeats
+};
+
+struct DedupOptions {
+    DuplicatePolicy policy{DuplicatePolicy::Allow};
+    int64_t window{0}; // dates up to this many seconds apart still count as the same
+};
+
+// Day number of an epoch, rounded down (also before 1970).
+static int64_t dedupDay(int64_t epoch) {
+    return epoch >= 0 ? epoch / kDedupDay : -((-epoch + kDedupDay - 1) / kDedupDay);
+}
+
+static uint64_t dedupMix(uint64_t h) { // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+// Hash of a merchant name after case folding, ignoring ASCII spaces and punctuation.
+static uint64_t merchantDedupHash(std::string_view merchant) {
+    uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+    forEachFoldedByte(merchant, [&](unsigned char b) {
+        if (b < 0x80 && !((b >= '0' && b <= '9') || (b >= 'a' && b <= 'z'))) return;
+        h = (h ^ b) * 0x100000001b3ull;
+    });
+    return h;
+}
+
+// Never 0, which marks an empty table slot.
+static uint64_t dedupKey(int64_t amount, uint64_t merchantHash, std::string_view txnId, int64_t day) {
+    uint64_t h = dedupMix(static_cast<uint64_t>(amount) ^ dedupMix(merchantHash + static_cast<uint64_t>(day)));
+    for (unsigned char c: txnId) h = (h ^ c) * 0x100000001b3ull;
+    h = dedupMix(h);
+    return h ? h : 1;
+}
+
+class DedupIndex {
+public:
+    void add(uint64_t key, uint32_t row) {
+        if ((count + 1) * 4 > keys.size() * 3) grow();
+        put(key, row);
+        setBits(key);
+        ++count;
+    }
+
+    // False means key was never added; true, that it probably was.
+    bool mayContain(uint64_t key) const {
+        if (bloom.empty()) return false;
+        const uint64_t* block = &bloom[blockOf(key)];
+        uint64_t h = bitsOf(key);
+        for (int k = 0; k < kBloomBits; ++k, h >>= 9) {
+            if (!(block[(h >> 6) & 7] >> (h & 63) & 1)) return false;
+        }
+        return true;
+    }
+
+    // f(row) for every row added under key, until f returns true; true if it did.
+    template <class F>
+    bool find(uint64_t key, F&& f) const {
+        if (!mayContain(key)) return false;
+        for (size_t i = key & (keys.size() - 1);; i = (i + 1) & (keys.size() - 1)) {
+            if (keys[i] == 0) return false;
+            if (keys[i] == key && f(rows[i])) return true;
+        }
+    }
+
+    size_t size() const { return count; }
+
+    void clear() {
+        std::vector<uint64_t>().swap(keys);
+        std::vector<uint32_t>().swap(rows);
+        std::vector<uint64_t>().swap(bloom);
+        count = 0;
+    }
+
+    size_t bytesReserved() const {
+        return keys.capacity() * sizeof(uint64_t) + rows.capacity() * sizeof(uint32_t) + bloom.capacity() * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr int kBloomBits = 6; // bits set per key, all in one block of 8 words
+    std::vector<uint64_t> keys;  // 0 = empty slot
+    std::vector<uint32_t> rows;
+    std::vector<uint64_t> bloom; // 8 bits per table slot, about 11 per key when full
+    size_t count{0};
+
+    size_t blockOf(uint64_t key) const { return static_cast<size_t>(key >> 32) * 8 & (bloom.size() - 1); }
+    static uint64_t bitsOf(uint64_t key) { return key * 0x9E3779B97F4A7C15ull; }
+
+    void setBits(uint64_t key) {
+        uint64_t* block = &bloom[blockOf(key)];
+        uint64_t h = bitsOf(key);
+        for (int k = 0; k < kBloomBits; ++k, h >>= 9) block[(h >> 6) & 7] |= uint64_t(1) << (h & 63);
+    }
+
+    void put(uint64_t key, uint32_t row) {
+        size_t i = key & (keys.size() - 1);
+        while (keys[i] != 0) i = (i + 1) & (keys.size() - 1);
+        keys[i] = key;
+        rows[i] = row;
+    }
+
+    void grow() {
+        std::vector<uint64_t> oldKeys(std::max<size_t>(1024, keys.size() * 2), 0);
+        std::vector<uint32_t> oldRows(oldKeys.size());
+        oldKeys.swap(keys);
+        oldRows.swap(rows);
+        bloom.assign(keys.size() / 8, 0);
+        for (size_t i = 0; i < oldKeys.size(); ++i) {
+            if (oldKeys[i] == 0) continue;
+            put(oldKeys[i], oldRows[i]);
+            setBits(oldKeys[i]);
+        }
+    }
+};
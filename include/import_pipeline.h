@@ -0,0 +1,268 @@
+#pragma once
+#include "repositories.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+// Bulk import as a pipeline of stages joined by bounded queues:
+//
+//   read      (1 thread)   cut the input into batches of whole records
+//   prepare   (N threads)  parse -> categorize each batch
+//   insert    (caller)     put batches back in input order, drop duplicates, repo.saveBatch
+//
+// A full queue blocks the stage feeding it, so at most a few batches per stage are in memory
+// however large the input is, and the repository is only touched from the calling thread.
+// Repo is a TransactionRepository, or anything with its saveBatch/reserve (such as the
+// ConcurrentTransactionStore, whose readers then see the import arrive batch by batch).
+// Duplicate detection (ImportOptions::dedup) needs a TransactionRepository; other
+// repositories save every row.
+
+// FIFO with a fixed capacity. push blocks while full, pop blocks while empty; after close()
+// push fails and pop drains what is left, then fails.
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity): cap(capacity ? capacity : 1) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lk(m);
+        notFull.wait(lk, [&] { return items.size() < cap || closed; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lk(m);
+        notEmpty.wait(lk, [&] { return !items.empty() || closed; });
+        if (items.empty()) return false;
+        out = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lk(m);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t cap;
+    std::deque<T> items;
+    bool closed{false};
+    std::mutex m;
+    std::condition_variable notFull, notEmpty;
+};
+
+struct ImportStats {
+    size_t imported{0};
+    size_t categorized{0}; // rows given a category, duplicates included
+    size_t rejected{0}; // failed to parse
+    size_t duplicates{0}; // repeated a stored row; not imported unless flagged
+    std::vector<std::pair<uint32_t, uint32_t>> flagged; // DuplicatePolicy::Flag: (new row, row it repeats)
+};
+
+struct ImportOptions {
+    size_t workers{0};      // prepare threads, 0 = one per core beyond the caller's
+    size_t batchRows{4096}; // records per batch
+    size_t queueBatches{4}; // capacity of each queue, in batches
+    // rows repeating a stored one (or an earlier row of the import), see findDuplicate
+    DedupOptions dedup{DuplicatePolicy::Reject, 0};
+    // called on the inserting thread after every batch
+    std::function<void(const ImportStats&)> progress;
+};
+
+struct ImportBatch {
+    size_t seq{0};
+    std::string_view text; // raw CSV records, when reading a file
+    std::vector<Transaction> rows;
+    size_t categorized{0};
+    size_t rejected{0};
+};
+
+// Categorize a parsed batch. categorize is either per row (t -> bool, true if it assigned a
+// category) or per batch ((rows, assigned) -> void, setting assigned[i] to 1 for every row it
+// categorized). Every row is kept: txnId is optional, and amounts are range-checked when parsed.
+template <class Categorize>
+static void categorizeBatch(ImportBatch& b, Categorize& categorize) {
+    std::vector<uint8_t> assigned(b.rows.size(), 0);
+    if constexpr (std::is_invocable_v<Categorize&, std::vector<Transaction>&, std::vector<uint8_t>&>) {
+        categorize(b.rows, assigned);
+    } else {
+        for (size_t i = 0; i < b.rows.size(); ++i) assigned[i] = categorize(b.rows[i]);
+    }
+    for (uint8_t a: assigned) b.categorized += a;
+}
+
+// repo.saveBatch, with duplicate detection where the repository has it. Returns the number of
+// rows stored.
+template <class Repo>
+static size_t saveImportBatch(Repo& repo, std::vector<Transaction>&& rows, const ImportOptions& opt, ImportStats& stats) {
+    size_t n = rows.size();
+    if constexpr (std::is_same_v<Repo, TransactionRepository>) {
+        size_t found = repo.saveBatch(std::move(rows), opt.dedup, &stats.flagged);
+        stats.duplicates += found;
+        if (opt.dedup.policy == DuplicatePolicy::Reject) n -= found;
+    } else {
+        repo.saveBatch(std::move(rows));
+    }
+    return n;
+}
+
+// Run the stages. read(batch) fills the next batch and returns false once the input is
+// exhausted; prepare(batch) runs on the worker threads. If any stage throws (an amount the
+// repository refuses, say), both queues are closed, every thread is joined and the first
+// exception is rethrown to the caller; rows saved before it stay saved.
+template <class Repo, class Read, class Prepare>
+static ImportStats runImportPipeline(Repo& repo, Read read, Prepare prepare, const ImportOptions& opt) {
+    size_t workers = opt.workers;
+    if (workers == 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        workers = hw > 1 ? hw - 1 : 1;
+    }
+    BoundedQueue<ImportBatch> readQueue(opt.queueBatches), doneQueue(opt.queueBatches + workers);
+    std::mutex failureMutex;
+    std::exception_ptr failure;
+    auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lk(failureMutex);
+            if (!failure) failure = std::current_exception();
+        }
+        readQueue.close();
+        doneQueue.close();
+    };
+
+    std::thread reader([&] {
+        try {
+            for (size_t seq = 0;; ++seq) {
+                ImportBatch b;
+                b.seq = seq;
+                if (!read(b) || !readQueue.push(std::move(b))) break;
+            }
+        } catch (...) { fail(); }
+        readQueue.close();
+    });
+    std::atomic<size_t> running{workers};
+    std::vector<std::thread> pool;
+    for (size_t w = 0; w < workers; ++w) {
+        pool.emplace_back([&] {
+            try {
+                ImportBatch b;
+                while (readQueue.pop(b)) {
+                    prepare(b);
+                    if (!doneQueue.push(std::move(b))) break;
+                }
+            } catch (...) { fail(); }
+            if (--running == 0) doneQueue.close();
+        });
+    }
+
+    // batches finish out of order; hold early ones until their predecessors arrive
+    ImportStats stats;
+    try {
+        std::map<size_t, ImportBatch> early;
+        size_t next = 0;
+        ImportBatch b;
+        while (doneQueue.pop(b)) {
+            early.emplace(b.seq, std::move(b));
+            for (auto it = early.begin(); it != early.end() && it->first == next; it = early.erase(it), ++next) {
+                stats.categorized += it->second.categorized;
+                stats.rejected += it->second.rejected;
+                stats.imported += saveImportBatch(repo, std::move(it->second.rows), opt, stats);
+                if (opt.progress) opt.progress(stats);
+            }
+        }
+    } catch (...) { fail(); }
+    reader.join();
+    for (auto &th: pool) th.join();
+    if (failure) std::rethrow_exception(failure);
+    return stats;
+}
+
+// Import in-memory rows; they are moved into the repository in their original order.
+template <class Repo, class Categorize>
+static ImportStats importRows(Repo& repo, std::vector<Transaction>&& rows, Categorize categorize, const ImportOptions& opt = {}) {
+    repo.reserve(rows.size());
+    const size_t batchRows = opt.batchRows ? opt.batchRows : 1;
+    size_t pos = 0;
+    auto read = [&](ImportBatch& b) {
+        if (pos >= rows.size()) return false;
+        size_t end = std::min(rows.size(), pos + batchRows);
+        b.rows.assign(std::make_move_iterator(rows.begin() + static_cast<std::ptrdiff_t>(pos)),
+                      std::make_move_iterator(rows.begin() + static_cast<std::ptrdiff_t>(end)));
+        pos = end;
+        return true;
+    };
+    auto prepare = [&](ImportBatch& b) { categorizeBatch(b, categorize); };
+    ImportStats stats = runImportPipeline(repo, read, prepare, opt);
+    rows.clear();
+    return stats;
+}
+
+// Stream a CSV file in the transactions.csv layout (txnId,amount,epoch,merchant,category,notes)
+// into the repository. The file is mapped, never loaded whole; records without a date get the
+// import time, categories are looked up in catRepo (which must not change meanwhile).
+template <class Repo, class Categorize>
+static ImportStats importCsvFile(Repo& repo, const std::string& path, CategoryRepository* catRepo, Categorize categorize, const ImportOptions& opt = {}) {
+    MappedFile file(path);
+    if (!file.isOpen()) return {};
+    LEDGER_COUNT(BytesRead, file.size());
+    const char* pos = file.begin();
+    const char* end = file.end();
+
+    // one reservation, sized from the record density of the first 64 KiB
+    size_t sample = std::min<size_t>(file.size(), 1 << 16);
+    size_t lines = static_cast<size_t>(std::count(pos, pos + sample, '\n'));
+    if (lines) repo.reserve(file.size() / (sample / lines) + 1);
+
+    const size_t batchRows = opt.batchRows ? opt.batchRows : 1;
+    auto read = [&](ImportBatch& b) {
+        // cut after batchRows newlines that are not inside quotes
+        const char* p = pos;
+        bool quoted = false;
+        size_t records = 0;
+        while (p < end && records < batchRows) {
+            char c = *p++;
+            if (c == '"') quoted = !quoted;
+            else if (c == '\n' && !quoted) ++records;
+        }
+        if (p == pos) return false;
+        b.text = std::string_view(pos, static_cast<size_t>(p - pos));
+        pos = p;
+        return true;
+    };
+    const auto now = std::chrono::system_clock::now();
+    auto prepare = [&](ImportBatch& b) {
+        const char* p = b.text.data();
+        const char* e = p + b.text.size();
+        CsvRecord rec;
+        b.rows.reserve(batchRows);
+        while (p < e) {
+            if (isBlankCsvLine(p, e)) { while (p < e && *p != '\n') ++p; if (p < e) ++p; continue; }
+            size_t n = parseCsvRecord(p, e, rec);
+            b.rows.emplace_back();
+            if (!TransactionRepository::fromCsvFields(rec.data(), n, b.rows.back(), catRepo, now)) {
+                b.rows.pop_back();
+                ++b.rejected;
+            }
+        }
+        categorizeBatch(b, categorize);
+    };
+    return runImportPipeline(repo, read, prepare, opt);
+}
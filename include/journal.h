@@ -0,0 +1,338 @@
+#pragma once
+#include "repositories.h"
+#include "snapshot.h"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+// Append-only change log sitting next to the CSV snapshots. Instead of rewriting
+// transactions.csv / categories.csv after every change, each mutation made through the
+// repositories is appended as one CSV record:
+//   T,<txnId,amount,epoch,merchant,categoryName,notes>   TransactionRepository::save
+//   X,<categoryName>                                      TransactionRepository::clearCategory
+//   C,<categoryId,name,type>                              CategoryRepository::save
+//   D,<name>                                              CategoryRepository::remove
+// A background thread writes appended records in batches with one fsync per batch (group
+// commit). Once the journal grows past half the snapshot, a compaction writes fresh snapshots
+// in the background and starts a new journal, so the amortized cost per change stays constant.
+//
+// A transactions path ending in ".snap" selects the binary columnar snapshot (snapshot.h)
+// instead of CSV, for both loading and compaction.
+//
+// Compaction renames the journal to "<journal>.old" before taking the snapshot copy. A .old file
+// left by a compaction whose snapshot write failed is never overwritten: the next rotation goes
+// to "<journal>.old.1" (then .old.2, ...), and the next snapshot that succeeds covers them all.
+// New snapshots are staged as "<file>.new"; "<journal>.install" then records how many rotated
+// journals they cover, and only after that do they replace the live files and the rotated
+// journals go. open() finishes an install whose marker is on disk, so a rotated journal is
+// either replayed whole (its snapshot never got installed) or deleted unread (it did): nothing
+// has to be matched record by record. Mutations and compact() are expected to come from the
+// same thread.
+class Journal : public ChangeListener {
+public:
+    Journal(std::string transactionsCsv, std::string categoriesCsv, std::string journalFile)
+    : txnPath(std::move(transactionsCsv)), catPath(std::move(categoriesCsv)),
+      logPath(std::move(journalFile)), oldPath(logPath + ".old") {}
+
+    ~Journal() { close(); }
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Load both snapshots, replay whatever the journal holds and start recording changes.
+    // Throws std::runtime_error if snapshots staged by an earlier compaction cannot be installed.
+    void open(TransactionRepository& txnRepo, CategoryRepository& catRepo) {
+        txns = &txnRepo;
+        cats = &catRepo;
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        if (fs::exists(installPath(), ec) && !finishInstall())
+            throw std::runtime_error("cannot install the snapshots recorded in " + installPath());
+        cats->loadFromCsv(catPath);
+        if (binarySnapshot()) loadSnapshot(txnPath, *txns, cats);
+        else txns->loadFromCsv(txnPath, cats);
+        snapshotRows = txns->size();
+        size_t leftover = rotatedCount();
+        for (size_t i = 0; i < leftover; ++i) replay(rotatedPath(i));
+        size_t replayed = replay(logPath);
+        if (leftover) {
+            // interrupted or failed compactions: settle them now so the .old files can go,
+            // rotating the live journal too so the new snapshot covers it
+            if (fs::exists(logPath, ec)) fs::rename(logPath, rotatedPath(leftover), ec);
+            if (!ec && writeSnapshots(txns->findAll(), categoryCopies(), rotatedCount())) {
+                replayed = 0;
+                snapshotRows = txns->size();
+            }
+        }
+        journalRecords = replayed;
+        out = std::fopen(logPath.c_str(), "ab");
+        stopping = false;
+        flusher = std::thread([this] { flushLoop(); });
+        txns->setListener(this);
+        cats->setListener(this);
+    }
+
+    // Block until every record appended so far has been written out. Records appended by other
+    // threads while a flush is in progress ride along with the next one. False if the journal is
+    // not open or a batch failed to reach the disk; the in-memory state is still complete, and
+    // failure is reported until a compaction has written it to a snapshot.
+    bool commit() {
+        std::unique_lock<std::mutex> lk(m);
+        uint64_t target = appendedSeq;
+        flushed.wait(lk, [&] { return durableSeq >= target || !out; });
+        return out && lostSeq == 0;
+    }
+
+    // Start a background compaction when the journal has outgrown the snapshot.
+    void maybeCompact() {
+        if (compacting) return;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (journalRecords < std::max(minCompactRecords, snapshotRows / 2)) return;
+        }
+        compact();
+    }
+
+    // Rotate the journal and rewrite the snapshots from the current in-memory state on a
+    // background thread. No-op while a previous compaction is still running.
+    void compact() {
+        if (!txns || compacting) return;
+        if (compactor.joinable()) compactor.join();
+        std::vector<Transaction> rows = txns->findAll().toTransactions();
+        std::vector<Category> catRows = categoryCopies();
+        size_t rotated = 0;
+        uint64_t covered = 0;
+        {
+            std::unique_lock<std::mutex> lk(m);
+            flushed.wait(lk, [&] { return (durableSeq == appendedSeq && !flushing) || !out; });
+            if (!out) return;
+            std::fclose(out);
+            std::error_code ec;
+            rotated = rotatedCount();
+            std::filesystem::rename(logPath, rotatedPath(rotated), ec);
+            out = std::fopen(logPath.c_str(), "ab");
+            if (ec) return; // the journal still holds everything; try again later
+            ++rotated;
+            covered = appendedSeq;
+            snapshotRows = rows.size();
+            journalRecords = 0;
+        }
+        compacting = true;
+        compactor = std::thread([this, rows = std::move(rows), catRows = std::move(catRows), n = rotated, covered]() mutable {
+            if (writeSnapshots(rows, catRows, n)) {
+                std::lock_guard<std::mutex> lk(m);
+                if (lostSeq <= covered) lostSeq = 0; // the snapshot holds what the journal lost
+            }
+            compacting = false;
+        });
+    }
+
+    // Flush outstanding records, finish any compaction and detach from the repositories.
+    void close() {
+        if (txns) txns->setListener(nullptr);
+        if (cats) cats->setListener(nullptr);
+        if (flusher.joinable()) {
+            {
+                std::lock_guard<std::mutex> lk(m);
+                stopping = true;
+            }
+            wake.notify_all();
+            flusher.join();
+        }
+        if (compactor.joinable()) compactor.join();
+        if (out) { std::fclose(out); out = nullptr; }
+        flushed.notify_all();
+    }
+
+    size_t pendingRecords() {
+        std::lock_guard<std::mutex> lk(m);
+        return journalRecords;
+    }
+
+    void transactionSaved(const Transaction& t) override {
+        std::string r = "T,";
+        TransactionRepository::appendCsvLine(r, t);
+        append(r);
+    }
+    void categoryCleared(const std::string& categoryName) override { append("X,\"" + escapeCsv(categoryName) + "\"\n"); }
+    void categorySaved(const Category& c) override {
+        std::string r = "C,";
+        CategoryRepository::appendCsvLine(r, c);
+        append(r);
+    }
+    void categoryRemoved(const std::string& name) override { append("D,\"" + escapeCsv(name) + "\"\n"); }
+
+    // below this many records a journal is never worth compacting
+    size_t minCompactRecords{4096};
+
+private:
+    std::string txnPath, catPath, logPath, oldPath;
+    TransactionRepository* txns{nullptr};
+    CategoryRepository* cats{nullptr};
+
+    std::mutex m;
+    std::condition_variable wake, flushed;
+    std::string pending;
+    uint64_t appendedSeq{0}, durableSeq{0};
+    uint64_t lostSeq{0}; // last record of the newest batch that failed to write, 0 if none
+    bool flushing{false}, stopping{false};
+    FILE* out{nullptr};
+    std::thread flusher, compactor;
+    std::atomic<bool> compacting{false};
+    size_t journalRecords{0}, snapshotRows{0};
+
+    std::string installPath() const { return logPath + ".install"; }
+
+    // Rotated journals, oldest first: "<journal>.old", then "<journal>.old.1", ... in rotation order.
+    std::string rotatedPath(size_t i) const { return i ? oldPath + "." + std::to_string(i) : oldPath; }
+
+    // Number of rotated journals on disk. Removal goes newest first, so they are always 0..n-1.
+    size_t rotatedCount() const {
+        std::error_code ec;
+        size_t n = 0;
+        while (std::filesystem::exists(rotatedPath(n), ec)) ++n;
+        return n;
+    }
+
+    void append(const std::string& record) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            pending += record;
+            ++appendedSeq;
+            ++journalRecords;
+        }
+        wake.notify_one();
+    }
+
+    void flushLoop() {
+        std::unique_lock<std::mutex> lk(m);
+        while (true) {
+            wake.wait(lk, [&] { return stopping || !pending.empty(); });
+            if (pending.empty()) break; // stopping
+            std::string batch;
+            batch.swap(pending);
+            uint64_t seq = appendedSeq;
+            FILE* f = out;
+            flushing = true;
+            lk.unlock();
+            bool ok = f != nullptr;
+            if (f) {
+                ok &= std::fwrite(batch.data(), 1, batch.size(), f) == batch.size();
+                ok &= syncFile(f);
+            }
+            lk.lock();
+            if (!ok) lostSeq = seq;
+            flushing = false;
+            durableSeq = seq;
+            flushed.notify_all();
+        }
+    }
+
+    std::vector<Category> categoryCopies() const {
+        std::vector<Category> out;
+        for (auto &c: cats->all()) out.push_back(*c);
+        return out;
+    }
+
+    // Stage both snapshots as "<file>.new", record that they cover rotated journals 0..covers-1,
+    // then install them. Rows is a std::vector<Transaction> or a TxnView.
+    template <class Rows>
+    bool writeSnapshots(const Rows& rows, const std::vector<Category>& catRows, size_t covers) {
+        auto writeFile = [](const std::string& path, auto& items) {
+            std::string tmp = path + ".tmp";
+            FILE* f = std::fopen(tmp.c_str(), "wb");
+            if (!f) return false;
+            std::string buf;
+            bool ok = true;
+            for (const auto &item: items) {
+                appendLine(buf, item);
+                if (buf.size() >= (1 << 16)) { ok &= std::fwrite(buf.data(), 1, buf.size(), f) == buf.size(); buf.clear(); }
+            }
+            ok &= std::fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+            ok &= syncFile(f);
+            ok &= std::fclose(f) == 0;
+            if (!ok) return false;
+            std::error_code ec;
+            std::filesystem::rename(tmp, path, ec);
+            return !ec;
+        };
+        bool ok = binarySnapshot() ? writeSnapshot(txnPath + ".new", rows) : writeFile(txnPath + ".new", rows);
+        std::vector<std::string> marker{std::to_string(covers)};
+        ok = ok && writeFile(catPath + ".new", catRows) && writeFile(installPath(), marker);
+        return ok && finishInstall();
+    }
+
+    // Move the staged snapshots over the live ones and drop the rotated journals the marker says
+    // they cover, then the marker. Safe to repeat after a crash at any step.
+    bool finishInstall() {
+        namespace fs = std::filesystem;
+        MappedFile marker(installPath());
+        if (!marker.isOpen()) return false;
+        size_t covers = 0;
+        const char* p = marker.begin();
+        while (p < marker.end() && *p >= '0' && *p <= '9') covers = covers * 10 + static_cast<size_t>(*p++ - '0');
+        if (p == marker.begin()) return false;
+        std::error_code ec;
+        for (const std::string* live: {&txnPath, &catPath}) {
+            std::string staged = *live + ".new";
+            if (!fs::exists(staged, ec)) continue; // moved before a crash
+            fs::rename(staged, *live, ec);
+            if (ec) return false;
+        }
+        for (size_t i = covers; i-- > 0;) fs::remove(rotatedPath(i), ec);
+        return fs::remove(installPath(), ec);
+    }
+
+    bool binarySnapshot() const {
+        return txnPath.size() >= 5 && txnPath.compare(txnPath.size() - 5, 5, ".snap") == 0;
+    }
+
+    static void appendLine(std::string& buf, const Transaction& t) { TransactionRepository::appendCsvLine(buf, t); }
+    static void appendLine(std::string& buf, const TxnRef& t) { TransactionRepository::appendCsvLine(buf, t); }
+    static void appendLine(std::string& buf, const Category& c) { CategoryRepository::appendCsvLine(buf, c); }
+    static void appendLine(std::string& buf, const std::string& line) { buf += line; buf += '\n'; }
+
+    // Apply every complete record of a journal file to the repositories. A torn record at the
+    // end (crash mid-write) is ignored. Returns the number of records applied.
+    size_t replay(const std::string& path) {
+        MappedFile file(path);
+        if (!file.isOpen() || file.size() == 0) return 0;
+        const auto now = std::chrono::system_clock::now();
+        size_t applied = 0;
+        CsvRecord rec;
+        const char* p = file.begin();
+        while (p < file.end()) {
+            if (isBlankCsvLine(p, file.end())) { while (p < file.end() && *p != '\n') ++p; if (p < file.end()) ++p; continue; }
+            size_t n = parseCsvRecord(p, file.end(), rec);
+            if (p[-1] != '\n') break;
+            if (n < 2 || rec[0].raw.size() != 1) continue;
+            const CsvField* f = rec.data() + 1;
+            switch (rec[0].raw[0]) {
+            case 'T': {
+                Transaction t;
+                if (!TransactionRepository::fromCsvFields(f, n - 1, t, cats, now)) continue;
+                txns->save(t);
+                break;
+            }
+            case 'X': txns->clearCategory(f[0].str()); break;
+            case 'C': {
+                Category c;
+                if (!CategoryRepository::fromCsvFields(f, n - 1, c)) continue;
+                cats->save(c);
+                break;
+            }
+            case 'D': cats->remove(f[0].str()); break;
+            default: continue;
+            }
+            ++applied;
+        }
+        return applied;
+    }
+};
@@ -0,0 +1,233 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+// Case-insensitive multi-keyword matcher (Aho-Corasick) used by CategorizerService.
+//
+// Keywords and scanned text go through the same simple case folding, one code point at a
+// time, and the automaton runs over the folded UTF-8 bytes, so each field is scanned once
+// no matter how many rules there are. Folding covers ASCII, Latin-1, Latin Extended-A,
+// Greek and Cyrillic; other code points (and invalid UTF-8 bytes) are matched as-is.
+
+static uint32_t foldCodePoint(uint32_t cp) {
+    if (cp < 0x80) return cp >= 'A' && cp <= 'Z' ? cp + 32 : cp;
+    if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) return cp + 0x20;
+    if (cp >= 0x100 && cp <= 0x17F) {
+        if (cp == 0x178) return 0xFF;
+        bool evenUpper = cp <= 0x137 || (cp >= 0x14A && cp <= 0x177);
+        if (cp == 0x130 || cp == 0x131 || cp == 0x138 || cp == 0x149 || cp == 0x17F) return cp;
+        if (evenUpper) return (cp & 1) == 0 ? cp + 1 : cp;
+        return (cp & 1) == 1 ? cp + 1 : cp;
+    }
+    if (cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) return cp + 0x20;
+    if (cp == 0x386) return 0x3AC;
+    if (cp >= 0x388 && cp <= 0x38A) return cp + 0x25;
+    if (cp == 0x38C) return 0x3CC;
+    if (cp == 0x38E || cp == 0x38F) return cp + 0x3F;
+    if (cp == 0x3C2) return 0x3C3; // final sigma
+    if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;
+    if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+    return cp;
+}
+
+// Call f(byte) for every byte of the case-folded UTF-8 form of s.
+template <class F>
+static void forEachFoldedByte(std::string_view s, F&& f) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+    const unsigned char* end = p + s.size();
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) { f(static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c + 32 : c)); ++p; continue; }
+        int len = c >= 0xF8 ? 0 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 ? 2 : 0;
+        bool valid = len > 0 && end - p >= len;
+        for (int k = 1; valid && k < len; ++k) valid = (p[k] & 0xC0) == 0x80;
+        if (!valid) { f(c); ++p; continue; }
+        if (len != 2) { for (int k = 0; k < len; ++k) f(p[k]); p += len; continue; }
+        // every code point that folds lies in the two-byte range, and folds into it
+        uint32_t folded = foldCodePoint((static_cast<uint32_t>(c & 0x1F) << 6) | (p[1] & 0x3F));
+        f(static_cast<unsigned char>(0xC0 | (folded >> 6)));
+        f(static_cast<unsigned char>(0x80 | (folded & 0x3F)));
+        p += 2;
+    }
+}
+
+static std::string foldCase(std::string_view s) {
+    std::string out;
+    out.reserve(s.size());
+    forEachFoldedByte(s, [&](unsigned char b) { out += static_cast<char>(b); });
+    return out;
+}
+
+// Rules are identified by the dense id add() returns. When several rules occur in a text the
+// one with the highest priority wins, ties going to the rule added first.
+//
+// Editing rules only touches the keyword trie; failure links and the flat transition tables
+// are rebuilt lazily, once, by the next match after any number of edits. Matching is safe
+// from several threads at once, but not concurrently with add/remove/setEnabled.
+class KeywordMatcher {
+public:
+    // Add a keyword (or change the priority of an existing one); returns its rule id.
+    int add(std::string_view keyword, int priority = 0) {
+        std::string key = foldCase(keyword);
+        if (key.empty()) return -1;
+        int node = 0;
+        for (unsigned char b: key) node = addChild(node, b);
+        int rule = trie[static_cast<size_t>(node)].rule;
+        if (rule < 0) {
+            rule = static_cast<int>(rules.size());
+            rules.push_back(Rule{priority, true, true});
+            trie[static_cast<size_t>(node)].rule = rule;
+        } else {
+            rules[static_cast<size_t>(rule)].priority = priority;
+            rules[static_cast<size_t>(rule)].present = true;
+        }
+        dirty = true;
+        return rule;
+    }
+
+    // Drop a keyword; its rule id is not reused. Returns the removed rule id or -1.
+    int remove(std::string_view keyword) {
+        int rule = find(keyword);
+        if (rule >= 0) { rules[static_cast<size_t>(rule)].present = false; dirty = true; }
+        return rule;
+    }
+
+    // Rule id of a keyword currently present, or -1.
+    int find(std::string_view keyword) const {
+        std::string key = foldCase(keyword);
+        int node = 0;
+        for (unsigned char b: key) {
+            node = child(node, b);
+            if (node < 0) return -1;
+        }
+        int rule = trie[static_cast<size_t>(node)].rule;
+        return rule >= 0 && rules[static_cast<size_t>(rule)].present ? rule : -1;
+    }
+
+    // Disabled rules stay in the trie but never match.
+    void setEnabled(int rule, bool on) {
+        auto &r = rules[static_cast<size_t>(rule)];
+        if (r.enabled != on) { r.enabled = on; dirty = true; }
+    }
+
+    int priority(int rule) const { return rules[static_cast<size_t>(rule)].priority; }
+    size_t ruleCount() const { return rules.size(); }
+
+    // True if rule a should win over rule b (-1 = no match).
+    bool better(int a, int b) const {
+        if (a < 0) return false;
+        if (b < 0) return true;
+        int pa = priority(a), pb = priority(b);
+        return pa != pb ? pa > pb : a < b;
+    }
+
+    // Rebuild now rather than on the next match (e.g. before handing the matcher to threads).
+    void build() const { compile(); }
+
+    // Best rule occurring anywhere in the text, or -1.
+    int bestMatch(std::string_view text) const {
+        compile();
+        int state = 0, best = -1;
+        forEachFoldedByte(text, [&](unsigned char b) {
+            state = step(state, b);
+            int hit = output[static_cast<size_t>(state)];
+            if (hit >= 0 && better(hit, best)) best = hit;
+        });
+        return best;
+    }
+
+private:
+    struct Node {
+        std::vector<std::pair<unsigned char, int>> next; // sorted by byte
+        int rule{-1};
+    };
+    struct Rule {
+        int priority;
+        bool present;
+        bool enabled;
+    };
+
+    std::vector<Node> trie{Node{}};
+    std::vector<Rule> rules;
+
+    // compiled form: root transitions are dense, the rest a sorted edge list per state
+    mutable std::atomic<bool> dirty{true};
+    mutable std::mutex compileMutex;
+    mutable int rootNext[256];
+    mutable std::vector<uint32_t> edgeStart;
+    mutable std::vector<unsigned char> edgeByte;
+    mutable std::vector<int> edgeTarget;
+    mutable std::vector<int> fail;
+    mutable std::vector<int> output; // best rule ending at this state, via suffixes too
+
+    static bool edgeBefore(const std::pair<unsigned char, int>& e, unsigned char v) { return e.first < v; }
+
+    int child(int node, unsigned char b) const {
+        auto &next = trie[static_cast<size_t>(node)].next;
+        auto it = std::lower_bound(next.begin(), next.end(), b, edgeBefore);
+        return it != next.end() && it->first == b ? it->second : -1;
+    }
+
+    int addChild(int node, unsigned char b) {
+        auto &next = trie[static_cast<size_t>(node)].next;
+        auto it = std::lower_bound(next.begin(), next.end(), b, edgeBefore);
+        if (it != next.end() && it->first == b) return it->second;
+        int id = static_cast<int>(trie.size());
+        next.insert(it, {b, id});
+        trie.emplace_back();
+        return id;
+    }
+
+    int step(int state, unsigned char b) const {
+        while (state != 0) {
+            const unsigned char* first = edgeByte.data() + edgeStart[static_cast<size_t>(state)];
+            const unsigned char* last = edgeByte.data() + edgeStart[static_cast<size_t>(state) + 1];
+            const unsigned char* it = std::lower_bound(first, last, b);
+            if (it != last && *it == b) return edgeTarget[static_cast<size_t>(it - edgeByte.data())];
+            state = fail[static_cast<size_t>(state)];
+        }
+        return rootNext[b];
+    }
+
+    void compile() const {
+        if (!dirty.load(std::memory_order_acquire)) return;
+        std::lock_guard<std::mutex> lk(compileMutex);
+        if (!dirty.load(std::memory_order_relaxed)) return;
+        const size_t n = trie.size();
+        edgeStart.assign(n + 1, 0);
+        edgeByte.clear();
+        edgeTarget.clear();
+        for (size_t s = 0; s < n; ++s) {
+            edgeStart[s] = static_cast<uint32_t>(edgeByte.size());
+            for (auto &e: trie[s].next) { edgeByte.push_back(e.first); edgeTarget.push_back(e.second); }
+        }
+        edgeStart[n] = static_cast<uint32_t>(edgeByte.size());
+        std::fill(rootNext, rootNext + 256, 0);
+        for (auto &e: trie[0].next) rootNext[e.first] = e.second;
+
+        // breadth-first, so a state's failure target is finished before the state itself
+        fail.assign(n, 0);
+        output.assign(n, -1);
+        std::vector<int> queue;
+        queue.reserve(n);
+        for (auto &e: trie[0].next) queue.push_back(e.second);
+        for (size_t qi = 0; qi < queue.size(); ++qi) {
+            int s = queue[qi];
+            const Node& node = trie[static_cast<size_t>(s)];
+            int own = node.rule;
+            if (own >= 0 && !(rules[static_cast<size_t>(own)].present && rules[static_cast<size_t>(own)].enabled)) own = -1;
+            int inherited = output[static_cast<size_t>(fail[static_cast<size_t>(s)])];
+            output[static_cast<size_t>(s)] = better(own, inherited) ? own : inherited;
+            for (auto &e: node.next) {
+                fail[static_cast<size_t>(e.second)] = s == 0 ? 0 : step(fail[static_cast<size_t>(s)], e.first);
+                queue.push_back(e.second);
+            }
+        }
+        dirty.store(false, std::memory_order_release);
+    }
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+// Hot-path instrumentation: call counts and latency histograms for the expensive operations,
+// plus throughput counters (rows scanned, bytes read/written, heap allocations).
+//
+// Compiled in only when LEDGER_METRICS is defined (the CMake option of the same name turns it
+// on for simple_ledger). Otherwise LEDGER_PROBE and LEDGER_COUNT expand to nothing, their
+// arguments are never evaluated and none of the code below exists.
+//
+//   LEDGER_PROBE(SearchByKeyword);          // times the rest of the enclosing scope
+//   LEDGER_COUNT(RowsScanned, rows.size()); // adds to a counter
+//
+// Everything is a relaxed atomic, so probes may fire from any thread; a probe costs two
+// steady_clock reads and a handful of uncontended increments.
+
+#ifdef LEDGER_METRICS
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+enum class Probe {
+    LoadFromCsv,
+    SaveToCsv,
+    AutoCategorize,
+    AutoCategorizeBatch,
+    TrainCategorizer,
+    ImportTransactions,
+    ImportFromCsv,
+    CategoryBreakdown,
+    CategoryBreakdownYear,
+    CategoryBreakdownAll,
+    CategoryBreakdownRange,
+    IncomeExpenseMonth,
+    IncomeExpenseYear,
+    IncomeExpenseRange,
+    IncomeExpenseSeries,
+    LargestExpenses,
+    TopMerchants,
+    AmountQuantiles,
+    SearchByKeyword,
+    Count
+};
+
+enum class Counter {
+    RowsScanned,    // rows visited by queries (range scans, keyword candidates)
+    RowsLoaded,     // rows read from CSV files and snapshots
+    BytesRead,      // input file bytes
+    BytesWritten,   // CSV bytes written by saveToCsv
+    Allocations,    // operator new calls (counted only by programs that hook it, see src/alloc_counter.cpp)
+    AllocatedBytes,
+    Count
+};
+
+class Metrics {
+public:
+    // Latencies go into power-of-two nanosecond buckets: bucket b holds [2^(b-1), 2^b) ns.
+    static constexpr int kBuckets = 48;
+
+    struct ProbeStats {
+        uint64_t count{0};
+        uint64_t totalNs{0};
+        uint64_t maxNs{0};
+        uint64_t allocations{0};
+        uint64_t buckets[kBuckets]{};
+
+        // Upper bound of the bucket holding quantile q, in ns (0 when nothing was recorded).
+        uint64_t quantileNs(double q) const {
+            uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count));
+            uint64_t seen = 0;
+            for (int b = 0; b < kBuckets; ++b) {
+                seen += buckets[b];
+                if (seen > rank) return std::min(uint64_t(1) << b, maxNs);
+            }
+            return maxNs;
+        }
+    };
+
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    static const char* name(Probe p) {
+        static const char* const names[] = {
+            "TransactionRepository.loadFromCsv",
+            "TransactionRepository.saveToCsv",
+            "CategorizerService.autoCategorize",
+            "CategorizerService.autoCategorizeBatch",
+            "CategorizerService.train",
+            "TransactionService.importTransactions",
+            "TransactionService.importFromCsv",
+            "ReportService.categoryBreakdown",
+            "ReportService.categoryBreakdownYear",
+            "ReportService.categoryBreakdownAll",
+            "ReportService.categoryBreakdownRange",
+            "ReportService.incomeExpenseTotalsMonth",
+            "ReportService.incomeExpenseTotalsYear",
+            "ReportService.incomeExpenseTotalsRange",
+            "ReportService.incomeExpenseSeries",
+            "QueryService.largestExpenses",
+            "QueryService.topMerchants",
+            "QueryService.amountQuantiles",
+            "TransactionRepository.searchByKeyword",
+        };
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Probe::Count), "probe names");
+        return names[static_cast<size_t>(p)];
+    }
+
+    static const char* name(Counter c) {
+        static const char* const names[] = {"rowsScanned", "rowsLoaded", "bytesRead", "bytesWritten", "allocations", "allocatedBytes"};
+        static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Counter::Count), "counter names");
+        return names[static_cast<size_t>(c)];
+    }
+
+    void record(Probe p, uint64_t ns, uint64_t allocations) {
+        Slot& s = probes[static_cast<size_t>(p)];
+        s.count.fetch_add(1, std::memory_order_relaxed);
+        s.totalNs.fetch_add(ns, std::memory_order_relaxed);
+        s.allocations.fetch_add(allocations, std::memory_order_relaxed);
+        uint64_t max = s.maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !s.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+        int b = 0;
+        while (b < kBuckets - 1 && (uint64_t(1) << b) <= ns) ++b;
+        s.buckets[b].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add(Counter c, uint64_t n) { counters[static_cast<size_t>(c)].fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t counter(Counter c) const { return counters[static_cast<size_t>(c)].load(std::memory_order_relaxed); }
+
+    ProbeStats stats(Probe p) const {
+        const Slot& s = probes[static_cast<size_t>(p)];
+        ProbeStats out;
+        out.count = s.count.load(std::memory_order_relaxed);
+        out.totalNs = s.totalNs.load(std::memory_order_relaxed);
+        out.maxNs = s.maxNs.load(std::memory_order_relaxed);
+        out.allocations = s.allocations.load(std::memory_order_relaxed);
+        for (int b = 0; b < kBuckets; ++b) out.buckets[b] = s.buckets[b].load(std::memory_order_relaxed);
+        return out;
+    }
+
+    void reset() {
+        for (auto &s: probes) {
+            s.count = 0; s.totalNs = 0; s.maxNs = 0; s.allocations = 0;
+            for (auto &b: s.buckets) b = 0;
+        }
+        for (auto &c: counters) c = 0;
+    }
+
+    // {"probes": {name: {count, totalMs, meanUs, p50Us, p90Us, p99Us, maxUs, allocations}},
+    //  "counters": {name: value}}. Probes that never fired are left out.
+    std::string toJson() const {
+        std::string out = "{\"probes\": {";
+        bool first = true;
+        for (size_t i = 0; i < static_cast<size_t>(Probe::Count); ++i) {
+            ProbeStats s = stats(static_cast<Probe>(i));
+            if (s.count == 0) continue;
+            char buf[512];
+            std::snprintf(buf, sizeof buf,
+                          "%s\"%s\": {\"count\": %llu, \"totalMs\": %.3f, \"meanUs\": %.3f, \"p50Us\": %.3f, "
+                          "\"p90Us\": %.3f, \"p99Us\": %.3f, \"maxUs\": %.3f, \"allocations\": %llu}",
+                          first ? "" : ", ", name(static_cast<Probe>(i)), static_cast<unsigned long long>(s.count),
+                          s.totalNs / 1e6, s.totalNs / 1e3 / static_cast<double>(s.count), s.quantileNs(0.5) / 1e3,
+                          s.quantileNs(0.9) / 1e3, s.quantileNs(0.99) / 1e3, s.maxNs / 1e3,
+                          static_cast<unsigned long long>(s.allocations));
+            out += buf;
+            first = false;
+        }
+        out += "}, \"counters\": {";
+        for (size_t i = 0; i < static_cast<size_t>(Counter::Count); ++i) {
+            if (i) out += ", ";
+            out += std::string("\"") + name(static_cast<Counter>(i)) + "\": " + std::to_string(counter(static_cast<Counter>(i)));
+        }
+        out += "}}\n";
+        return out;
+    }
+
+    // The same as an aligned table, for the menu.
+    std::string toText() const {
+        std::string out;
+        char buf[256];
+        std::snprintf(buf, sizeof buf, "%-40s %9s %11s %10s %10s %10s %10s %9s\n", "probe", "calls", "total ms",
+                      "mean us", "p50 us", "p99 us", "max us", "allocs");
+        out += buf;
+        for (size_t i = 0; i < static_cast<size_t>(Probe::Count); ++i) {
+            ProbeStats s = stats(static_cast<Probe>(i));
+            if (s.count == 0) continue;
+            std::snprintf(buf, sizeof buf, "%-40s %9llu %11.3f %10.3f %10.3f %10.3f %10.3f %9llu\n",
+                          name(static_cast<Probe>(i)), static_cast<unsigned long long>(s.count), s.totalNs / 1e6,
+                          s.totalNs / 1e3 / static_cast<double>(s.count), s.quantileNs(0.5) / 1e3,
+                          s.quantileNs(0.99) / 1e3, s.maxNs / 1e3, static_cast<unsigned long long>(s.allocations));
+            out += buf;
+        }
+        for (size_t i = 0; i < static_cast<size_t>(Counter::Count); ++i) {
+            std::snprintf(buf, sizeof buf, "%-16s %llu\n", name(static_cast<Counter>(i)),
+                          static_cast<unsigned long long>(counter(static_cast<Counter>(i))));
+            out += buf;
+        }
+        return out;
+    }
+
+private:
+    // one cache line apart, so threads hitting different probes do not share lines
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> count{0}, totalNs{0}, maxNs{0}, allocations{0};
+        std::atomic<uint64_t> buckets[kBuckets]{};
+    };
+    Slot probes[static_cast<size_t>(Probe::Count)];
+    std::atomic<uint64_t> counters[static_cast<size_t>(Counter::Count)]{};
+};
+
+// Records the time from construction to destruction, and the allocations made meanwhile (by
+// any thread), against a probe.
+class ScopedProbe {
+public:
+    explicit ScopedProbe(Probe p)
+        : probe(p), allocations(Metrics::instance().counter(Counter::Allocations)), start(std::chrono::steady_clock::now()) {}
+    ~ScopedProbe() {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        Metrics& m = Metrics::instance();
+        m.record(probe, static_cast<uint64_t>(ns), m.counter(Counter::Allocations) - allocations);
+    }
+    ScopedProbe(const ScopedProbe&) = delete;
+    ScopedProbe& operator=(const ScopedProbe&) = delete;
+
+private:
+    Probe probe;
+    uint64_t allocations;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define LEDGER_PROBE_CONCAT2(a, b) a##b
+#define LEDGER_PROBE_CONCAT(a, b) LEDGER_PROBE_CONCAT2(a, b)
+#define LEDGER_PROBE(probe) ScopedProbe LEDGER_PROBE_CONCAT(ledgerProbe, __LINE__)(Probe::probe)
+#define LEDGER_COUNT(counter, n) Metrics::instance().add(Counter::counter, static_cast<uint64_t>(n))
+
+#else
+
+#define LEDGER_PROBE(probe) ((void)0)
+#define LEDGER_COUNT(counter, n) ((void)0)
+
+#endif
@@ -3,8 +3,7 @@
 #include <vector>
 #include <memory>
 #include <chrono>
-
-using Decimal = double;
+#include "decimal.h"
 
 struct User {
     std::string userId;
@@ -24,6 +23,7 @@ struct Category {
     std::string categoryId;
     std::string name;
     CategoryType type{CategoryType::Expense};
+    int id{-1}; // dense id interned from the name by CategoryRepository, -1 until then
 };
 
 struct Transaction {
@@ -33,5 +33,7 @@ struct Transaction {
     std::string merchant;
     std::shared_ptr<Category> category; // may be nullptr before categorization
     std::string notes;
+    std::string userId;    // owner; empty in single-user ledgers
+    std::string accountId; // account within the owner's ledger, may be empty
     bool isIncome() const { return category ? category->type==CategoryType::Income : amount>0; }
 };
@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// Trigram inverted index for substring search over UTF-8 text.
+//
+// Grams are three consecutive code points (not bytes), so a CJK merchant name of n characters
+// yields n - 2 grams rather than 3n - 2 mostly useless byte triples. Each gram maps to the
+// ascending list of rows containing it; a query is answered by intersecting the lists of its
+// own grams, which gives every row that could contain it (callers verify the candidates).
+// Queries shorter than three code points cannot use the index.
+
+// Code points of s; a byte that does not start a valid sequence becomes 0xDC00 + byte, which
+// never collides with a decoded code point.
+static void decodeCodePoints(std::string_view s, std::vector<uint32_t>& out) {
+    out.clear();
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data());
+    const unsigned char* end = p + s.size();
+    while (p < end) {
+        unsigned char c = *p;
+        if (c < 0x80) { out.push_back(c); ++p; continue; }
+        int len = c >= 0xF8 ? 0 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC2 ? 2 : 0;
+        bool valid = len > 0 && end - p >= len;
+        for (int k = 1; valid && k < len; ++k) valid = (p[k] & 0xC0) == 0x80;
+        if (!valid) { out.push_back(0xDC00u + c); ++p; continue; }
+        uint32_t cp = c & (0x7F >> len);
+        for (int k = 1; k < len; ++k) cp = (cp << 6) | (p[k] & 0x3F);
+        out.push_back(cp);
+        p += len;
+    }
+}
+
+class NgramIndex {
+public:
+    // Index text as part of a row. Rows must arrive in non-decreasing order; a row may be
+    // added several times (once per field).
+    void add(uint32_t row, std::string_view text) {
+        decodeCodePoints(text, points);
+        for (size_t i = 0; i + 3 <= points.size(); ++i) {
+            auto &list = postings[gram(&points[i])];
+            if (list.empty() || list.back() != row) list.push_back(row);
+        }
+    }
+
+    // Rows that may contain query, ascending. Returns false (out untouched) when the query has
+    // fewer than three code points and the index cannot narrow it down.
+    bool candidates(std::string_view query, std::vector<uint32_t>& out) const {
+        std::vector<uint32_t> q;
+        decodeCodePoints(query, q);
+        if (q.size() < 3) return false;
+        std::vector<const std::vector<uint32_t>*> lists;
+        for (size_t i = 0; i + 3 <= q.size(); ++i) {
+            auto it = postings.find(gram(&q[i]));
+            if (it == postings.end()) { out.clear(); return true; }
+            lists.push_back(&it->second);
+        }
+        std::sort(lists.begin(), lists.end());
+        lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+        std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+        out = *lists[0];
+        std::vector<uint32_t> next;
+        for (size_t l = 1; l < lists.size() && !out.empty(); ++l) {
+            // binary-search the longer list for each survivor, resuming from the last hit
+            const auto &other = *lists[l];
+            next.clear();
+            auto from = other.begin();
+            for (uint32_t row: out) {
+                from = std::lower_bound(from, other.end(), row);
+                if (from == other.end()) break;
+                if (*from == row) next.push_back(row);
+            }
+            out.swap(next);
+        }
+        return true;
+    }
+
+    size_t gramCount() const { return postings.size(); }
+
+    // Approximate heap bytes: posting lists plus hash nodes and buckets.
+    size_t bytesReserved() const {
+        size_t n = postings.bucket_count() * sizeof(void*);
+        for (auto &kv: postings) n += kv.second.capacity() * sizeof(uint32_t) + sizeof(kv) + 2 * sizeof(void*);
+        return n;
+    }
+
+private:
+    std::unordered_map<uint64_t, std::vector<uint32_t>> postings;
+    std::vector<uint32_t> points; // scratch for add()
+
+    // code points fit in 21 bits, so three of them pack into one key
+    static uint64_t gram(const uint32_t* cp) {
+        return (static_cast<uint64_t>(cp[0]) << 42) | (static_cast<uint64_t>(cp[1]) << 21) | cp[2];
+    }
+};
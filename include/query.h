@@ -0,0 +1,171 @@
+#pragma once
+#include "repositories.h"
+#include "sketches.h"
+#include "metrics.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Ranking and distribution queries: "largest 20 expenses this year", "top merchants by spend",
+// "median and p95 transaction size in Food". Each is one pass over the repository's
+// date-ordered columns (and the sealed blocks the range overlaps) in bounded memory (an n-entry heap, one counter per interned merchant,
+// or a KLL sketch), with no copy of the rows and no full sort.
+//
+// Partial results merge: TopN::merge, mergeMerchantSpend and QuantileSketch::merge combine
+// the answers of several repositories (shards, ConcurrentTransactionStore segments) or of
+// threads that each took part of a range into the answer over all of them.
+
+// A transaction with the amount it was ranked by. `txn` is a view: it stays valid while its
+// repository is unchanged.
+struct RankedTxn {
+    Decimal amount;
+    TxnRef txn;
+};
+
+// Larger |amount| ranks higher; on a tie, the earlier transaction (then the smaller id).
+struct ByMagnitude {
+    bool operator()(const RankedTxn& a, const RankedTxn& b) const {
+        Decimal x = a.amount < Decimal() ? -a.amount : a.amount;
+        Decimal y = b.amount < Decimal() ? -b.amount : b.amount;
+        if (x != y) return x < y;
+        if (a.txn.date != b.txn.date) return a.txn.date > b.txn.date;
+        return a.txn.txnId > b.txn.txnId;
+    }
+};
+
+struct MerchantSpend {
+    std::string merchant;
+    Decimal spend;      // sum of |amount| over the merchant's expenses
+    uint64_t count{0};  // number of those expenses
+};
+
+// merchant -> spend, for merging across repositories before ranking
+using MerchantSpendMap = std::map<std::string, MerchantSpend, std::less<>>;
+
+inline void mergeMerchantSpend(MerchantSpendMap& into, const MerchantSpendMap& from) {
+    for (auto &kv: from) {
+        auto &m = into[kv.first];
+        m.merchant = kv.first;
+        m.spend += kv.second.spend;
+        m.count += kv.second.count;
+    }
+}
+
+// The n merchants with the highest spend, highest first (ties by name).
+inline std::vector<MerchantSpend> topMerchants(const MerchantSpendMap& spend, size_t n) {
+    auto less = [](const MerchantSpend& a, const MerchantSpend& b) {
+        return a.spend != b.spend ? a.spend < b.spend : a.merchant > b.merchant;
+    };
+    TopN<MerchantSpend, decltype(less)> top(n, less);
+    for (auto &kv: spend) top.push(kv.second);
+    return top.sorted();
+}
+
+class QueryService {
+public:
+    explicit QueryService(const TransactionRepository& r): repo(r) {}
+
+    // The n largest expenses dated in [from, to), optionally in one category ("" for all).
+    // Call sorted() on the result for largest first, or merge it with other parts first.
+    TopN<RankedTxn, ByMagnitude> largestExpenses(int64_t from, int64_t to, size_t n, const std::string& category = "") const {
+        LEDGER_PROBE(LargestExpenses);
+        TopN<RankedTxn, ByMagnitude> top(n);
+        int32_t slot = category.empty() ? -1 : repo.slotOfName(category);
+        if (!category.empty() && slot < 0) return top;
+        repo.scanColumns(from, to, [&](const TransactionRepository::ColumnSlice& cols) {
+            for (size_t i = 0; i < cols.size; ++i) {
+                int64_t a = cols.amounts[i];
+                if (a >= 0 || (slot >= 0 && cols.slots[i] != slot)) continue;
+                // most rows lose to the current n-th largest on the amount alone
+                if (top.full() && -a < (-top.threshold().amount).raw()) continue;
+                top.push(RankedTxn{Decimal::fromRaw(a), repo.ref(cols.rows[i])});
+            }
+        });
+        return top;
+    }
+
+    // Spend per merchant over [from, to), for merging; see topMerchants for a ranking.
+    MerchantSpendMap merchantSpend(int64_t from, int64_t to) const {
+        MerchantSpendMap out;
+        std::vector<int64_t> spend;
+        std::vector<uint64_t> count;
+        accumulateMerchants(from, to, spend, count);
+        for (size_t id = 1; id < spend.size(); ++id) {
+            if (!count[id]) continue;
+            std::string name(repo.merchantName(static_cast<uint32_t>(id)));
+            out[name] = MerchantSpend{name, Decimal::fromRaw(spend[id]), count[id]};
+        }
+        return out;
+    }
+
+    // The n merchants with the highest spend over [from, to), highest first: one pass into a
+    // counter per interned merchant, then a bounded heap over the merchants.
+    std::vector<MerchantSpend> topMerchants(int64_t from, int64_t to, size_t n) const {
+        LEDGER_PROBE(TopMerchants);
+        std::vector<int64_t> spend;
+        std::vector<uint64_t> count;
+        accumulateMerchants(from, to, spend, count);
+        auto less = [&](uint32_t a, uint32_t b) {
+            return spend[a] != spend[b] ? spend[a] < spend[b] : repo.merchantName(a) > repo.merchantName(b);
+        };
+        TopN<uint32_t, decltype(less)> top(n, less);
+        for (size_t id = 1; id < spend.size(); ++id) {
+            if (count[id]) top.push(static_cast<uint32_t>(id));
+        }
+        std::vector<MerchantSpend> out;
+        for (uint32_t id: top.sorted()) out.push_back(MerchantSpend{std::string(repo.merchantName(id)), Decimal::fromRaw(spend[id]), count[id]});
+        return out;
+    }
+
+    // Distribution of |amount| in a category ("" for every category), all time. Kept by the
+    // repository as rows arrive, so this costs a copy of the sketch(es), not a scan.
+    QuantileSketch amountSketch(const std::string& category = "") const {
+        if (!category.empty()) {
+            int32_t slot = repo.slotOfName(category);
+            return slot < 0 ? QuantileSketch() : repo.amountSketch(static_cast<size_t>(slot));
+        }
+        QuantileSketch all;
+        for (size_t slot = 0; slot < repo.slotCount(); ++slot) all.merge(repo.amountSketch(slot));
+        return all;
+    }
+
+    // The same over the rows dated in [from, to), in one pass.
+    QuantileSketch amountSketch(const std::string& category, int64_t from, int64_t to) const {
+        QuantileSketch out;
+        int32_t slot = category.empty() ? -1 : repo.slotOfName(category);
+        if (!category.empty() && slot < 0) return out;
+        repo.scanColumns(from, to, [&](const TransactionRepository::ColumnSlice& cols) {
+            for (size_t i = 0; i < cols.size; ++i) {
+                if (slot >= 0 && cols.slots[i] != slot) continue;
+                int64_t a = cols.amounts[i];
+                out.add(a < 0 ? -a : a);
+            }
+        });
+        return out;
+    }
+
+    // e.g. amountQuantiles("Food", {0.5, 0.95}) for the median and p95 (ascending qs), all time.
+    std::vector<Decimal> amountQuantiles(const std::string& category, const std::vector<double>& qs) const {
+        LEDGER_PROBE(AmountQuantiles);
+        std::vector<Decimal> out;
+        for (int64_t v: amountSketch(category).quantiles(qs)) out.push_back(Decimal::fromRaw(v));
+        return out;
+    }
+
+private:
+    const TransactionRepository& repo;
+
+    void accumulateMerchants(int64_t from, int64_t to, std::vector<int64_t>& spend, std::vector<uint64_t>& count) const {
+        spend.assign(repo.merchantIdLimit(), 0);
+        count.assign(repo.merchantIdLimit(), 0);
+        repo.scanColumns(from, to, [&](const TransactionRepository::ColumnSlice& cols) {
+            for (size_t i = 0; i < cols.size; ++i) {
+                if (cols.amounts[i] >= 0) continue;
+                spend[cols.merchants[i]] -= cols.amounts[i];
+                ++count[cols.merchants[i]];
+            }
+        });
+    }
+};
@@ -1,5 +1,14 @@
 #pragma once
 #include "models.h"
+#include "csv.h"
+#include "dates.h"
+#include "ngram_index.h"
+#include "timeseries.h"
+#include "sketches.h"
+#include "arena.h"
+#include "cold_blocks.h"
+#include "dedup_index.h"
+#include "metrics.h"
 #include <vector>
 #include <map>
 #include <optional>
@@ -7,39 +16,25 @@
 #include <algorithm>
 #include <memory>
 #include <fstream>
-#include <sstream>
-
-// small CSV helpers used by both CategoryRepository and TransactionRepository
-static std::string escapeCsv(const std::string& s) {
-    std::string out;
-    for (char c: s) {
-        if (c == '"') out += "\"\""; // double the quote
-        else out += c;
-    }
-    return out;
-}
-
-static std::string unescapeCsv(const std::string& s) {
-    std::string out;
-    for (size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == '"' && i + 1 < s.size() && s[i+1] == '"') { out += '"'; ++i; }
-        else out += s[i];
-    }
-    return out;
-}
-
-// Very small CSV parser: splits on commas, trims surrounding quotes
-static std::vector<std::string> splitCsvLine(const std::string& line) {
-    std::vector<std::string> parts;
-    std::istringstream ss(line);
-    std::string token;
-    while (std::getline(ss, token, ',')) {
-        if (!token.empty() && token.front() == '"') token.erase(token.begin());
-        if (!token.empty() && token.back() == '"') token.pop_back();
-        parts.push_back(token);
-    }
-    return parts;
-}
+#include <cmath>
+#include <unordered_map>
+#include <type_traits>
+#include <deque>
+#include <mutex>
+#include <limits>
+#include <iterator>
+#include <cstring>
+#include <string_view>
+
+// Receives every mutation made through the repositories (used by the journal).
+class ChangeListener {
+public:
+    virtual ~ChangeListener() = default;
+    virtual void transactionSaved(const Transaction&) {}
+    virtual void categoryCleared(const std::string& /*categoryName*/) {}
+    virtual void categorySaved(const Category&) {}
+    virtual void categoryRemoved(const std::string& /*name*/) {}
+};
 
 class CategoryRepository {
 public:
@@ -51,7 +46,10 @@ public:
 
     std::shared_ptr<Category> save(const Category& c) {
         auto ptr = std::make_shared<Category>(c);
+        ptr->id = intern(c.name);
         byName[c.name] = ptr;
+        ++changes;
+        if (listener) listener->categorySaved(c);
         return ptr;
     }
 
@@ -65,6 +63,63 @@ public:
         auto it = byName.find(name);
         if (it==byName.end()) return false;
         byName.erase(it);
+        ++changes;
+        if (listener) listener->categoryRemoved(name);
+        return true;
+    }
+
+    void setListener(ChangeListener* l) { listener = l; }
+
+    // Bumped by every save/remove; lets callers cache findByName results.
+    uint64_t generation() const { return changes; }
+
+    // Category names are interned to small dense ids shared by every repository in the
+    // process, so transactions can be grouped and filtered by integer instead of by name.
+    // An id stays bound to its name even after the category is removed.
+    static int intern(const std::string& name) {
+        auto& t = idTable();
+        std::lock_guard<std::mutex> lk(t.m);
+        return internLocked(t, name);
+    }
+
+    // Stamp the interned id on every category of these rows that has none yet, under the
+    // intern lock, so threads may do this on Category objects they share. A thread that has
+    // done it can read those ids without further locking.
+    static void stampIds(const Transaction* rows, size_t n) {
+        auto& t = idTable();
+        std::lock_guard<std::mutex> lk(t.m);
+        for (size_t i = 0; i < n; ++i) {
+            if (rows[i].category && rows[i].category->id < 0) rows[i].category->id = internLocked(t, rows[i].category->name);
+        }
+    }
+
+    static std::string nameOf(int id) {
+        auto& t = idTable();
+        std::lock_guard<std::mutex> lk(t.m);
+        return t.names.at(static_cast<size_t>(id));
+    }
+
+    // -1 if the name was never interned
+    static int idOf(const std::string& name) {
+        auto& t = idTable();
+        std::lock_guard<std::mutex> lk(t.m);
+        auto it = t.ids.find(name);
+        return it == t.ids.end() ? -1 : it->second;
+    }
+
+    // Append one CSV record (with trailing newline): categoryId,name,type
+    static void appendCsvLine(std::string& out, const Category& c) {
+        out += '"'; out += escapeCsv(c.categoryId); out += "\",\"";
+        out += escapeCsv(c.name); out += "\",";
+        out += std::to_string(static_cast<int>(c.type)); out += '\n';
+    }
+
+    static bool fromCsvFields(const CsvField* f, size_t n, Category& c) {
+        if (n < 3) return false;
+        c.categoryId = f[0].str();
+        c.name = f[1].str();
+        int ti = 0; parseCsvInt(f[2], ti);
+        c.type = (ti==1) ? CategoryType::Income : CategoryType::Expense;
         return true;
     }
 
@@ -72,125 +127,1139 @@ public:
     void saveToCsv(const std::string& path) const {
         std::ofstream ofs(path, std::ios::trunc);
         if (!ofs) return;
-        for (auto &p: byName) {
-            auto &c = *p.second;
-            int t = static_cast<int>(c.type);
-            ofs << '"' << escapeCsv(c.categoryId) << '"' << ','
-                << '"' << escapeCsv(c.name) << '"' << ','
-                << t << '\n';
-        }
+        std::string buf;
+        for (auto &p: byName) appendCsvLine(buf, *p.second);
+        ofs << buf;
     }
 
     void loadFromCsv(const std::string& path) {
-        std::ifstream ifs(path);
-        if (!ifs) return;
-        std::string line;
-        while (std::getline(ifs, line)) {
-            if (line.empty()) continue;
-            std::vector<std::string> parts = splitCsvLine(line);
-            if (parts.size() < 3) continue;
-            Category c;
-            c.categoryId = unescapeCsv(parts[0]);
-            c.name = unescapeCsv(parts[1]);
-            int ti = 0; try { ti = std::stoi(parts[2]); } catch(...) { ti = 0; }
-            c.type = (ti==1) ? CategoryType::Income : CategoryType::Expense;
-            save(c);
-        }
+        MappedFile file(path);
+        if (!file.isOpen()) return;
+        auto rows = parseCsvParallel<Category>(file.begin(), file.end(),
+            [](const CsvRecord& f, size_t n, Category& c) { return fromCsvFields(f.data(), n, c); });
+        for (auto &c: rows) save(c);
     }
 
 private:
     std::map<std::string, std::shared_ptr<Category>> byName;
+    ChangeListener* listener{nullptr};
+    uint64_t changes{0};
+
+    struct IdTable {
+        std::mutex m;
+        std::unordered_map<std::string, int> ids;
+        std::deque<std::string> names;
+    };
+    static IdTable& idTable() {
+        static IdTable table;
+        return table;
+    }
+    static int internLocked(IdTable& t, const std::string& name) {
+        auto it = t.ids.find(name);
+        if (it != t.ids.end()) return it->second;
+        int id = static_cast<int>(t.names.size());
+        t.names.push_back(name);
+        t.ids.emplace(name, id);
+        return id;
+    }
+};
+
+class TransactionRepository;
+
+// A stored transaction as seen through the repository: the fields of Transaction, with the
+// strings viewing repository-owned storage. The views and the category pointer stay valid as
+// long as the repository does (stored text is never moved), or until sealBefore; converting
+// to a Transaction makes an independent copy.
+struct TxnRef {
+    std::string_view txnId;
+    Decimal amount;
+    std::chrono::system_clock::time_point date;
+    std::string_view merchant;
+    const Category* category{nullptr};
+    std::string_view notes;
+    std::string_view userId;
+    std::string_view accountId;
+
+    bool isIncome() const { return category ? category->type==CategoryType::Income : amount>0; }
+
+    operator Transaction() const {
+        Transaction t;
+        t.txnId = std::string(txnId);
+        t.amount = amount;
+        t.date = date;
+        t.merchant = std::string(merchant);
+        if (owner) t.category = *owner;
+        t.notes = std::string(notes);
+        t.userId = std::string(userId);
+        t.accountId = std::string(accountId);
+        return t;
+    }
+
+private:
+    friend class TransactionRepository;
+    const std::shared_ptr<Category>* owner{nullptr};
+};
+
+// Read-only list of matching transactions. Holds row numbers (or, for findAll, just a count)
+// and builds TxnRefs on access instead of copying. Rows are never removed, so a view stays
+// usable while the repository lives (sealBefore renumbers rows, though, and invalidates it);
+// it does not pick up rows saved after it was made.
+class TxnView {
+public:
+    // Keeps the current TxnRef, so `for (auto &t: view)` works as it did with Transactions.
+    class iterator {
+    public:
+        iterator(const TxnView* v, size_t i): view(v), pos(i) {}
+        inline const TxnRef& operator*() const;
+        const TxnRef* operator->() const { return &**this; }
+        iterator& operator++() { ++pos; return *this; }
+        bool operator==(const iterator& o) const { return pos == o.pos; }
+        bool operator!=(const iterator& o) const { return pos != o.pos; }
+    private:
+        const TxnView* view;
+        size_t pos;
+        mutable TxnRef current;
+    };
+
+    TxnView(const TransactionRepository& r, std::vector<uint32_t> i): repo(&r), idx(std::move(i)), count(idx.size()), all(false) {}
+    // every row in [0, n)
+    TxnView(const TransactionRepository& r, size_t n): repo(&r), count(n), all(true) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    inline TxnRef operator[](size_t i) const;
+    TxnRef front() const { return (*this)[0]; }
+    TxnRef back() const { return (*this)[count - 1]; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, count); }
+    uint32_t rowNumber(size_t i) const { return all ? static_cast<uint32_t>(i) : idx[i]; }
+
+    // Independent copies, e.g. to hand to another thread.
+    std::vector<Transaction> toTransactions() const {
+        std::vector<Transaction> out;
+        out.reserve(count);
+        for (size_t i = 0; i < count; ++i) out.push_back((*this)[i]);
+        return out;
+    }
+    operator std::vector<Transaction>() const { return toTransactions(); }
+
+private:
+    const TransactionRepository* repo;
+    std::vector<uint32_t> idx;
+    size_t count;
+    bool all;
 };
 
 class TransactionRepository {
 public:
     void save(const Transaction& t) {
-        txns.push_back(t);
+        if (rows.size() == rows.capacity()) reserve(rows.size() + 1);
+        append(t);
+        if (listener) listener->transactionSaved(t);
     }
 
-    // Clear category references for transactions that referenced this category name
+    void setListener(ChangeListener* l) { listener = l; }
+
+    // Clear category references for transactions that referenced this category name.
+    // Only the rows on that category's posting list are touched.
     void clearCategory(const std::string& categoryName) {
-        for (auto &t: txns) {
-            if (t.category && t.category->name == categoryName) t.category = nullptr;
+        int32_t slot = slotForName(categoryName);
+        if (slot > 0 && static_cast<size_t>(slot) < postings.size()) {
+            auto &list = postings[static_cast<size_t>(slot)];
+            for (uint32_t row: list) {
+                rowSlots[row - coldRows] = 0;
+                byDateSlots[rowPositions[row - coldRows]] = 0;
+            }
+            auto &none = postings[0];
+            std::vector<uint32_t> merged(none.size() + list.size());
+            std::merge(none.begin(), none.end(), list.begin(), list.end(), merged.begin());
+            none.swap(merged);
+            std::vector<uint32_t>().swap(list);
+            auto &months = slotMonths[static_cast<size_t>(slot)];
+            for (auto &kv: months) slotMonths[0][kv.first] += kv.second;
+            months.clear();
+            dayTotals.moveSeries(absSeries(static_cast<size_t>(slot)), absSeries(0));
+            dayTotals.moveSeries(absSeries(static_cast<size_t>(slot)) + 1, absSeries(0) + 1);
+            slotSketches[0].merge(slotSketches[static_cast<size_t>(slot)]);
+            slotSketches[static_cast<size_t>(slot)] = QuantileSketch();
+            for (auto &b: cold) b.clearSlot(slot);
         }
+        if (listener) listener->categoryCleared(categoryName);
     }
 
-    std::vector<Transaction> findAll() const { return txns; }
+    // Label used for transactions without a category in breakdowns
+    static constexpr const char* kUncategorized = "Uncategorized";
 
-    std::vector<Transaction> findByUserAndMonth(const std::string& /*userId*/, int year, int month) const {
-        std::vector<Transaction> out;
-        for (auto &t: txns) {
-            auto tt = std::chrono::system_clock::to_time_t(t.date);
-            tm local;
-#ifdef _WIN32
-            localtime_s(&local, &tt);
-#else
-            localtime_r(&tt, &local);
-#endif
-            if (local.tm_year + 1900 == year && (local.tm_mon+1) == month) out.push_back(t);
+    // Contiguous, date-ordered columns of some rows.
+    struct ColumnSlice {
+        const int64_t* epochs;
+        const int64_t* amounts;    // Decimal::raw() units
+        const int32_t* slots;
+        size_t size;
+        const uint32_t* rows;      // row numbers, for ref()
+        const uint32_t* merchants; // merchant ids, see merchantName
+    };
+
+    // Visit the rows dated in [from, to) (epoch seconds) as column slices: one for each sealed
+    // block the range overlaps, decoded into scratch columns, then one straight over the
+    // resident date-ordered columns. Each slice is in date order; together they are not.
+    template <class F>
+    void scanColumns(int64_t from, int64_t to, F&& f) const {
+        sortColumns();
+        if (!cold.empty()) {
+            ColumnBuffer buf;
+            for (auto &block: cold) {
+                if (!block.zoneMap().overlaps(from, to)) continue;
+                buf.clear();
+                block.forEachIn(from, to, [&](uint32_t row, const ColdRow& r) { buf.push(row, r); });
+                LEDGER_COUNT(RowsScanned, buf.rows.size());
+                if (!buf.rows.empty()) f(buf.slice());
+            }
+        }
+        size_t b = static_cast<size_t>(std::lower_bound(byDateEpochs.begin(), byDateEpochs.end(), from) - byDateEpochs.begin());
+        size_t e = static_cast<size_t>(std::lower_bound(byDateEpochs.begin() + b, byDateEpochs.end(), to) - byDateEpochs.begin());
+        LEDGER_COUNT(RowsScanned, e - b);
+        f(ColumnSlice{byDateEpochs.data() + b, byDateAmounts.data() + b, byDateSlots.data() + b, e - b, byDateRows.data() + b,
+                      byDateMerchants.data() + b});
+    }
+
+    // Category slots index the posting lists and the per-slot aggregates:
+    // slot 0 is "Uncategorized", slot id + 1 is the category with that interned id.
+    size_t slotCount() const { return postings.size(); }
+    std::string slotName(size_t slot) const { return slot == 0 ? std::string(kUncategorized) : CategoryRepository::nameOf(static_cast<int>(slot) - 1); }
+
+    // Slot of a category name: 0 for "Uncategorized", -1 when the repository has no such slot.
+    int32_t slotOfName(const std::string& categoryName) const {
+        if (categoryName == kUncategorized) return 0;
+        int32_t slot = slotForName(categoryName);
+        return slot > 0 && static_cast<size_t>(slot) < postings.size() ? slot : -1;
+    }
+
+    // Distribution of |amount| in a slot, all time, kept up to date like the other aggregates.
+    const QuantileSketch& amountSketch(size_t slot) const { return slotSketches[slot]; }
+
+    // Merchants are interned: rows with the same merchant share an id below merchantIdLimit()
+    // (ids are dense but shared with user and account names).
+    uint32_t merchantId(uint32_t row) const {
+        if (row < coldRows) {
+            const ColdBlock& b = blockOf(row);
+            return b.row(row - b.firstRow()).merchant;
+        }
+        return rows[row - coldRows].merchant;
+    }
+    std::string_view merchantName(uint32_t id) const { return strings[id]; }
+    size_t merchantIdLimit() const { return strings.size(); }
+
+    struct IncomeExpense { Decimal income{0}, expense{0}; };
+
+    // Materialized aggregates, kept up to date by save / loadRows / clearCategory.
+    // Months are identified by monthKey(year, month); ranges are [firstKey, endKey).
+    Decimal balance() const { return runningBalance; }
+
+    IncomeExpense incomeExpense(int firstKey, int endKey) const {
+        IncomeExpense out;
+        for (auto it = monthTotals.lower_bound(firstKey); it != monthTotals.end() && it->first < endKey; ++it) {
+            out.income += it->second.income;
+            out.expense += it->second.expense;
         }
         return out;
     }
 
-    std::vector<Transaction> findByCategory(const std::string& categoryName) const {
-        std::vector<Transaction> out;
-        for (auto &t: txns) {
-            if (t.category && t.category->name == categoryName) out.push_back(t);
+    // Sum of |amount| per category name ("Uncategorized" for none), O(categories * log months).
+    std::map<std::string, Decimal> categoryTotals(int firstKey, int endKey) const {
+        std::map<std::string, Decimal> out;
+        for (size_t slot = 0; slot < slotMonths.size(); ++slot) {
+            auto &months = slotMonths[slot];
+            auto it = months.lower_bound(firstKey);
+            if (it == months.end() || it->first >= endKey) continue;
+            Decimal sum = 0;
+            for (; it != months.end() && it->first < endKey; ++it) sum += it->second;
+            out[slotName(slot)] += sum;
         }
         return out;
     }
 
-    std::vector<Transaction> searchByKeyword(const std::string& kw) const {
-        std::vector<Transaction> out;
-        for (auto &t: txns) {
-            if (t.notes.find(kw) != std::string::npos || t.merchant.find(kw) != std::string::npos) out.push_back(t);
+    std::map<std::string, Decimal> categoryTotalsAll() const {
+        return categoryTotals(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    }
+
+    // Arbitrary [from, to) epoch ranges (last 30 days, a custom quarter, ...), from the
+    // per-day Fenwick trees: O(log days), plus a scan of at most half a day's rows at each end.
+    IncomeExpense incomeExpenseBetween(int64_t from, int64_t to) const {
+        IncomeExpense out;
+        if (from >= to) return out;
+        int64_t sums[2] = {0, 0};
+        sortColumns();
+        addPrefix(to, 1, sums, 0, 2);
+        addPrefix(from, -1, sums, 0, 2);
+        out.income = Decimal::fromRaw(sums[0]);
+        out.expense = Decimal::fromRaw(sums[1]);
+        return out;
+    }
+
+    // Sum of |amount| per category name over [from, to), like categoryTotals.
+    std::map<std::string, Decimal> categoryTotalsBetween(int64_t from, int64_t to) const {
+        std::map<std::string, Decimal> out;
+        if (from >= to) return out;
+        std::vector<int64_t> sums(2 * postings.size(), 0);
+        sortColumns();
+        addPrefix(to, 1, sums.data(), absSeries(0), sums.size());
+        addPrefix(from, -1, sums.data(), absSeries(0), sums.size());
+        for (size_t slot = 0; slot < postings.size(); ++slot) {
+            if (sums[2 * slot + 1] > 0) out[slotName(slot)] += Decimal::fromRaw(sums[2 * slot]);
+        }
+        return out;
+    }
+
+    // Income and expense in each [bounds[i], bounds[i + 1]) for ascending bounds: one exact
+    // prefix per bound, so an N-point series costs N + 1 prefixes.
+    std::vector<IncomeExpense> incomeExpenseSeries(const std::vector<int64_t>& bounds) const {
+        std::vector<IncomeExpense> out;
+        if (bounds.size() < 2) return out;
+        sortColumns();
+        int64_t prev[2] = {0, 0};
+        addPrefix(bounds[0], 1, prev, 0, 2);
+        for (size_t i = 1; i < bounds.size(); ++i) {
+            int64_t cur[2] = {0, 0};
+            addPrefix(bounds[i], 1, cur, 0, 2);
+            out.push_back({Decimal::fromRaw(cur[0] - prev[0]), Decimal::fromRaw(cur[1] - prev[1])});
+            prev[0] = cur[0];
+            prev[1] = cur[1];
+        }
+        return out;
+    }
+
+    // |amount| of one category in each [bounds[i], bounds[i + 1]).
+    std::vector<Decimal> categorySeries(const std::string& categoryName, const std::vector<int64_t>& bounds) const {
+        std::vector<Decimal> out;
+        if (bounds.size() < 2) return out;
+        int32_t slot = slotOfName(categoryName);
+        if (slot < 0) return std::vector<Decimal>(bounds.size() - 1);
+        sortColumns();
+        size_t series = absSeries(static_cast<size_t>(slot));
+        int64_t prev = 0;
+        addPrefix(bounds[0], 1, &prev, series, 1);
+        for (size_t i = 1; i < bounds.size(); ++i) {
+            int64_t cur = 0;
+            addPrefix(bounds[i], 1, &cur, series, 1);
+            out.push_back(Decimal::fromRaw(cur - prev));
+            prev = cur;
         }
         return out;
     }
 
+    // Consistency check: recompute every aggregate from the rows and compare with the stored
+    // values. Decimal sums are exact, so any difference is a real mismatch; mismatches are
+    // described in `problems` when given.
+    bool verifyAggregates(std::string* problems=nullptr) const {
+        TransactionRepository fresh;
+        bool ok = true;
+        auto report = [&](const std::string& what, Decimal stored, Decimal expected) {
+            ok = false;
+            if (problems) *problems += what + ": stored " + stored.toString() + ", recomputed " + expected.toString() + "\n";
+        };
+        // sealed rows, and each block's zone map against its own rows
+        for (size_t i = 0; i < cold.size(); ++i) {
+            TransactionRepository block;
+            cold[i].forEach([&](uint32_t, const ColdRow& r) {
+                fresh.aggregate(r.epoch(), Decimal::fromRaw(r.amount), r.slot);
+                block.aggregate(r.epoch(), Decimal::fromRaw(r.amount), r.slot);
+            });
+            const ZoneMap& zone = cold[i].zoneMap();
+            std::string name = "block " + std::to_string(i) + " ";
+            IncomeExpense sums = block.incomeExpense(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+            if (Decimal::fromRaw(zone.income) != sums.income) report(name + "income", Decimal::fromRaw(zone.income), sums.income);
+            if (Decimal::fromRaw(zone.expense) != sums.expense) report(name + "expense", Decimal::fromRaw(zone.expense), sums.expense);
+            for (size_t slot = 0; slot < block.slotMonths.size(); ++slot) {
+                Decimal expected;
+                for (auto &kv: block.slotMonths[slot]) expected += kv.second;
+                Decimal stored = Decimal::fromRaw(zone.totalIn(static_cast<int32_t>(slot)));
+                if (stored != expected) report(name + slotName(slot), stored, expected);
+            }
+        }
+        for (size_t i = 0; i < rows.size(); ++i) fresh.aggregate(toEpoch(dateOf(rows[i])), Decimal::fromRaw(rows[i].amount), rowSlots[i]);
+        if (runningBalance != fresh.runningBalance) report("balance", runningBalance, fresh.runningBalance);
+        auto monthName = [](int key) { return std::to_string(keyYear(key)) + "-" + std::to_string(keyMonth(key)); };
+        auto sameKeys = [](auto& a, auto& b) {
+            if (a.size() != b.size()) return false;
+            for (auto &kv: a) if (!b.count(kv.first)) return false;
+            return true;
+        };
+        if (!sameKeys(monthTotals, fresh.monthTotals)) report("months with totals", (Decimal)monthTotals.size(), (Decimal)fresh.monthTotals.size());
+        for (auto &kv: fresh.monthTotals) {
+            auto it = monthTotals.find(kv.first);
+            IncomeExpense stored = it == monthTotals.end() ? IncomeExpense{} : it->second;
+            if (stored.income != kv.second.income) report("income " + monthName(kv.first), stored.income, kv.second.income);
+            if (stored.expense != kv.second.expense) report("expense " + monthName(kv.first), stored.expense, kv.second.expense);
+        }
+        for (size_t slot = 0; slot < std::max(slotMonths.size(), fresh.slotMonths.size()); ++slot) {
+            static const std::map<int, Decimal> none;
+            auto &stored = slot < slotMonths.size() ? slotMonths[slot] : none;
+            auto &expected = slot < fresh.slotMonths.size() ? fresh.slotMonths[slot] : none;
+            if (!sameKeys(stored, expected)) report("months with " + slotName(slot), (Decimal)stored.size(), (Decimal)expected.size());
+            for (auto &kv: expected) {
+                auto it = stored.find(kv.first);
+                Decimal value = it == stored.end() ? Decimal() : it->second;
+                if (value != kv.second) report(slotName(slot) + " " + monthName(kv.first), value, kv.second);
+            }
+        }
+        // daily trees, day by day over both spans
+        int64_t firstDay = std::min(dayTotals.firstDay(), fresh.dayTotals.firstDay());
+        int64_t endDay = std::max(dayTotals.firstDay() + static_cast<int64_t>(dayTotals.days()),
+                                  fresh.dayTotals.firstDay() + static_cast<int64_t>(fresh.dayTotals.days()));
+        for (size_t s = 0; s < std::max(dayTotals.seriesCount(), fresh.dayTotals.seriesCount()); ++s) {
+            for (int64_t day = firstDay; day < endDay; ++day) {
+                int64_t stored = dayTotals.dayValue(s, day), expected = fresh.dayTotals.dayValue(s, day);
+                if (stored == expected) continue;
+                std::string what = s < 2 ? (s == 0 ? "daily income" : "daily expense")
+                                         : (s % 2 ? "daily count " : "daily total ") + slotName(s / 2 - 1);
+                report(what + " day " + std::to_string(day), Decimal::fromRaw(stored), Decimal::fromRaw(expected));
+            }
+        }
+        return ok;
+    }
+
+    TxnView findAll() const { return TxnView(*this, size()); }
+
+    size_t size() const { return coldRows + rows.size(); }
+
+    // Row `row` (insertion order; sealed rows first, see sealBefore), see TxnRef.
+    TxnRef ref(uint32_t row) const {
+        if (row < coldRows) {
+            const ColdBlock& b = blockOf(row);
+            return refOf(b.row(row - b.firstRow()));
+        }
+        const StoredRow& r = rows[row - coldRows];
+        TxnRef t;
+        t.txnId = std::string_view(r.text, r.idLen);
+        t.amount = Decimal::fromRaw(r.amount);
+        t.date = dateOf(r);
+        t.merchant = strings[r.merchant];
+        const auto &owner = slotCategories[static_cast<size_t>(rowSlots[row - coldRows])];
+        if (owner) { t.category = owner.get(); t.owner = &owner; }
+        t.notes = std::string_view(r.text + r.idLen, r.notesLen);
+        t.userId = strings[r.user];
+        t.accountId = strings[r.account];
+        return t;
+    }
+
+    // Visit every transaction (as a TxnRef) in row order. Sealed blocks are decoded in one
+    // sequential pass each.
+    template <class F>
+    void forEach(F&& f) const {
+        for (auto &b: cold) b.forEach([&](uint32_t, const ColdRow& r) { f(refOf(r)); });
+        for (size_t i = 0; i < rows.size(); ++i) f(ref(coldRows + static_cast<uint32_t>(i)));
+    }
+
+    // Move every row dated before `cutoff` out of the resident tables into compressed,
+    // immutable blocks (cold_blocks.h): history that no longer changes stops costing row,
+    // column, posting-list and text-index memory, and range queries skip it by zone map.
+    // Aggregates are unaffected. Sealed rows are renumbered ahead of the resident ones, in date
+    // order, so row numbers, TxnViews and TxnRefs taken before the call are invalidated (the
+    // resident rows' text moves to a fresh arena). Rows saved later with older dates stay
+    // resident. Returns the number of rows sealed.
+    size_t sealBefore(int64_t cutoff) {
+        sortColumns();
+        size_t n = static_cast<size_t>(std::lower_bound(byDateEpochs.begin(), byDateEpochs.end(), cutoff) - byDateEpochs.begin());
+        if (n == 0) return 0;
+        std::vector<ColdRow> batch;
+        batch.reserve(std::min(n, ColdBlock::kMaxRows));
+        for (size_t i = 0; i < n; i += ColdBlock::kMaxRows) {
+            batch.clear();
+            for (size_t j = i; j < std::min(n, i + ColdBlock::kMaxRows); ++j) {
+                const StoredRow& r = rows[byDateRows[j] - coldRows];
+                batch.push_back(ColdRow{r.ticks, r.amount, byDateSlots[j], r.merchant, r.user, r.account,
+                                        std::string_view(r.text, r.idLen), std::string_view(r.text + r.idLen, r.notesLen)});
+            }
+            cold.emplace_back(batch.data(), batch.size(), coldRows + static_cast<uint32_t>(i));
+        }
+
+        // the resident rows keep their order and are numbered after the sealed ones
+        const uint32_t sealedRows = coldRows + static_cast<uint32_t>(n);
+        std::vector<uint32_t> renumber(rows.size(), UINT32_MAX);
+        for (size_t j = n; j < byDateRows.size(); ++j) renumber[byDateRows[j] - coldRows] = 0;
+        std::vector<StoredRow> kept;
+        std::vector<int32_t> keptSlots;
+        StringArena keptText;
+        kept.reserve(rows.size() - n);
+        keptSlots.reserve(rows.size() - n);
+        for (size_t h = 0; h < rows.size(); ++h) {
+            if (renumber[h] == UINT32_MAX) continue;
+            renumber[h] = sealedRows + static_cast<uint32_t>(kept.size());
+            StoredRow r = rows[h];
+            char* at = keptText.allocate(r.idLen + r.notesLen);
+            if (at) std::memcpy(at, r.text, r.idLen + r.notesLen);
+            r.text = at;
+            kept.push_back(r);
+            keptSlots.push_back(rowSlots[h]);
+        }
+        auto dropSealed = [&](auto& column) {
+            column.erase(column.begin(), column.begin() + static_cast<std::ptrdiff_t>(n));
+            column.shrink_to_fit();
+        };
+        dropSealed(byDateEpochs);
+        dropSealed(byDateRows);
+        dropSealed(byDateAmounts);
+        dropSealed(byDateSlots);
+        dropSealed(byDateMerchants);
+        for (auto &row: byDateRows) row = renumber[row - coldRows];
+        for (auto &list: postings) {
+            std::vector<uint32_t> next;
+            for (uint32_t row: list) if (renumber[row - coldRows] != UINT32_MAX) next.push_back(renumber[row - coldRows]);
+            list.swap(next);
+        }
+        rows.swap(kept);
+        rowSlots.swap(keptSlots);
+        text = std::move(keptText);
+        coldRows = sealedRows;
+        rowPositions.assign(rows.size(), 0);
+        rowPositions.shrink_to_fit();
+        for (size_t i = 0; i < byDateRows.size(); ++i) rowPositions[byDateRows[i] - coldRows] = static_cast<uint32_t>(i);
+        sortedPrefix = byDateEpochs.size();
+        textIndex = NgramIndex();
+        textIndexed = 0;
+        dedupIndex.clear();
+        dedupIndexed = 0;
+        return n;
+    }
+
+    size_t sealedRows() const { return coldRows; }
+    size_t sealedBlocks() const { return cold.size(); }
+    const ZoneMap& zoneMap(size_t block) const { return cold[block].zoneMap(); }
+
+    // Heap bytes held, by part; see ledger_bench for per-row figures.
+    struct MemoryUsage {
+        size_t rows;    // fixed-size row records
+        size_t strings; // ids, notes and the interned merchant/user/account pool
+        size_t indexes; // date columns, slots, posting lists, text index, daily totals
+        size_t sealed;  // compressed blocks of sealed rows, zone maps included
+        size_t total() const { return rows + strings + indexes + sealed; }
+    };
+
+    MemoryUsage memoryUsage() const {
+        auto bytes = [](const auto& v) { return v.capacity() * sizeof(v[0]); };
+        MemoryUsage m{};
+        m.rows = bytes(rows);
+        m.strings = text.bytesReserved() + strings.bytesReserved();
+        m.indexes = bytes(byDateEpochs) + bytes(byDateRows) + bytes(byDateAmounts) + bytes(byDateSlots) +
+                    bytes(byDateMerchants) + bytes(rowPositions) + bytes(rowSlots) + textIndex.bytesReserved() + dayTotals.bytesReserved() +
+                    dedupIndex.bytesReserved() + bytes(merchantHashes);
+        for (auto &s: slotSketches) m.indexes += s.bytesReserved();
+        for (auto &p: postings) m.indexes += bytes(p);
+        m.sealed = bytes(cold);
+        for (auto &b: cold) m.sealed += b.bytesReserved();
+        return m;
+    }
+
+    // Transactions of one user dated in the given month, in date order. An empty userId
+    // matches every user. For many users, ShardedTransactionRepository keeps each user's rows
+    // apart so this does not have to skip over everyone else's.
+    TxnView findByUserAndMonth(const std::string& userId, int year, int month) const {
+        std::vector<uint32_t> out;
+        auto range = monthBounds(year, month);
+        sortColumns();
+        auto b = std::lower_bound(byDateEpochs.begin(), byDateEpochs.end(), range.first);
+        auto e = std::lower_bound(b, byDateEpochs.end(), range.second);
+        auto first = byDateRows.begin() + (b - byDateEpochs.begin());
+        auto last = byDateRows.begin() + (e - byDateEpochs.begin());
+        LEDGER_COUNT(RowsScanned, last - first);
+        int64_t user = userId.empty() ? 0 : strings.find(userId);
+        if (user < 0) return TxnView(*this, std::move(out));
+        if (userId.empty()) out.assign(first, last);
+        else std::copy_if(first, last, std::back_inserter(out), [&](uint32_t r) { return rows[r - coldRows].user == user; });
+        // sealed rows of the month go first, merged by date
+        std::vector<std::pair<int64_t, uint32_t>> sealed;
+        for (auto &block: cold) {
+            block.forEachIn(range.first, range.second, [&](uint32_t row, const ColdRow& r) {
+                if (userId.empty() || r.user == user) sealed.emplace_back(r.epoch(), row);
+            });
+        }
+        if (sealed.empty()) return TxnView(*this, std::move(out));
+        LEDGER_COUNT(RowsScanned, sealed.size());
+        std::stable_sort(sealed.begin(), sealed.end(), [](auto& a, auto& b) { return a.first < b.first; });
+        std::vector<uint32_t> merged;
+        merged.reserve(sealed.size() + out.size());
+        size_t i = 0;
+        for (uint32_t row: out) {
+            int64_t epoch = byDateEpochs[rowPositions[row - coldRows]];
+            for (; i < sealed.size() && sealed[i].first <= epoch; ++i) merged.push_back(sealed[i].second);
+            merged.push_back(row);
+        }
+        for (; i < sealed.size(); ++i) merged.push_back(sealed[i].second);
+        return TxnView(*this, std::move(merged));
+    }
+
+    // Visit transactions dated in [from, to) (epoch seconds) in date order: two binary
+    // searches in the date index, then a contiguous scan.
+    // Sealed blocks are skipped by zone map; rows of the ones that overlap are decoded first and
+    // merged in by date.
+    template <class F>
+    void forEachInRange(int64_t from, int64_t to, F&& f) const {
+        sortColumns();
+        auto b = std::lower_bound(byDateEpochs.begin(), byDateEpochs.end(), from);
+        auto e = std::lower_bound(b, byDateEpochs.end(), to);
+        LEDGER_COUNT(RowsScanned, e - b);
+        std::vector<std::pair<int64_t, TxnRef>> sealed;
+        for (auto &block: cold) block.forEachIn(from, to, [&](uint32_t, const ColdRow& r) { sealed.emplace_back(r.epoch(), refOf(r)); });
+        LEDGER_COUNT(RowsScanned, sealed.size());
+        std::stable_sort(sealed.begin(), sealed.end(), [](auto& x, auto& y) { return x.first < y.first; });
+        size_t i = 0;
+        for (auto it = b; it != e; ++it) {
+            for (; i < sealed.size() && sealed[i].first <= *it; ++i) f(sealed[i].second);
+            f(ref(byDateRows[static_cast<size_t>(it - byDateEpochs.begin())]));
+        }
+        for (; i < sealed.size(); ++i) f(sealed[i].second);
+    }
+
+    // Resident rows come straight from the category's posting list; sealed blocks are decoded
+    // only when their zone map counts rows of the category.
+    TxnView findByCategory(const std::string& categoryName) const {
+        int32_t slot = slotForName(categoryName);
+        if (slot <= 0 || static_cast<size_t>(slot) >= postings.size()) return TxnView(*this, std::vector<uint32_t>());
+        std::vector<uint32_t> out;
+        for (auto &block: cold) {
+            if (block.zoneMap().rowsIn(slot) == 0) continue;
+            block.forEach([&](uint32_t row, const ColdRow& r) { if (r.slot == slot) out.push_back(row); });
+        }
+        if (out.empty()) return TxnView(*this, postings[static_cast<size_t>(slot)]);
+        auto &list = postings[static_cast<size_t>(slot)];
+        out.insert(out.end(), list.begin(), list.end());
+        return TxnView(*this, std::move(out));
+    }
+
+    // Substring match on notes or merchant. Candidates come from the trigram index and are
+    // verified; keywords under three characters fall back to a scan. A sealed block is decoded
+    // only if its text or one of its merchant names contains the keyword.
+    TxnView searchByKeyword(const std::string& kw) const {
+        LEDGER_PROBE(SearchByKeyword);
+        auto matches = [&](uint32_t i) {
+            const StoredRow& r = rows[i - coldRows];
+            return std::string_view(r.text + r.idLen, r.notesLen).find(kw) != std::string_view::npos ||
+                   strings[r.merchant].find(kw) != std::string_view::npos;
+        };
+        std::vector<uint32_t> out;
+        for (auto &block: cold) {
+            bool may = block.textContains(kw);
+            for (size_t k = 0; !may && k < block.stringIds().size(); ++k) may = strings[block.stringIds()[k]].find(kw) != std::string_view::npos;
+            if (!may) continue;
+            LEDGER_COUNT(RowsScanned, block.size());
+            block.forEach([&](uint32_t row, const ColdRow& r) {
+                if (r.notes.find(kw) != std::string_view::npos || strings[r.merchant].find(kw) != std::string_view::npos) out.push_back(row);
+            });
+        }
+        std::vector<uint32_t> resident;
+        updateTextIndex();
+        if (textIndex.candidates(kw, resident)) {
+            LEDGER_COUNT(RowsScanned, resident.size());
+            resident.erase(std::remove_if(resident.begin(), resident.end(), [&](uint32_t i) { return !matches(i); }), resident.end());
+        } else {
+            LEDGER_COUNT(RowsScanned, rows.size());
+            for (size_t i = 0; i < rows.size(); ++i) if (matches(coldRows + static_cast<uint32_t>(i))) resident.push_back(coldRows + static_cast<uint32_t>(i));
+        }
+        if (out.empty()) return TxnView(*this, std::move(resident));
+        out.insert(out.end(), resident.begin(), resident.end());
+        return TxnView(*this, std::move(out));
+    }
+
     // Persist all transactions into a CSV file. Fields: txnId,amount,epoch,merchant,categoryName,notes
+    // and, for rows that belong to a user or account, userId,accountId.
     void saveToCsv(const std::string& path) const {
+        LEDGER_PROBE(SaveToCsv);
         std::ofstream ofs(path, std::ios::trunc);
         if (!ofs) return;
-        for (auto &t: txns) {
-            // epoch seconds
-            auto tt = std::chrono::system_clock::to_time_t(t.date);
-            std::string categoryName = t.category ? t.category->name : "";
-            ofs << '"' << escapeCsv(t.txnId) << '"' << ','
-                << t.amount << ',' << tt << ','
-                << '"' << escapeCsv(t.merchant) << '"' << ','
-                << '"' << escapeCsv(categoryName) << '"' << ','
-                << '"' << escapeCsv(t.notes) << '"' << '\n';
+        std::string buf;
+        forEach([&](const TxnRef& t) {
+            appendCsvLine(buf, t);
+            if (buf.size() >= (1 << 16)) { LEDGER_COUNT(BytesWritten, buf.size()); ofs << buf; buf.clear(); }
+        });
+        LEDGER_COUNT(BytesWritten, buf.size());
+        ofs << buf;
+    }
+
+    // Append one CSV record (with trailing newline): txnId,amount,epoch,merchant,categoryName,notes
+    // then userId,accountId only when either is set, so single-user files keep six fields.
+    // Row is a Transaction or a TxnRef.
+    template <class Row>
+    static void appendCsvLine(std::string& out, const Row& t) {
+        char num[32];
+        out += '"'; out += escapeCsv(t.txnId); out += "\",";
+        t.amount.appendTo(out); out += ',';
+        auto tt = std::chrono::system_clock::to_time_t(t.date); // epoch seconds
+        out.append(num, std::to_chars(num, num + sizeof num, static_cast<long long>(tt)).ptr); out += ",\"";
+        out += escapeCsv(t.merchant); out += "\",\"";
+        if (t.category) out += escapeCsv(t.category->name);
+        out += "\",\""; out += escapeCsv(t.notes); out += '"';
+        if (!t.userId.empty() || !t.accountId.empty()) {
+            out += ",\""; out += escapeCsv(t.userId); out += "\",\""; out += escapeCsv(t.accountId); out += '"';
+        }
+        out += '\n';
+    }
+
+    // Inverse of appendCsvLine. Category names are resolved through catRepo when given;
+    // an unparsable epoch falls back to `fallbackDate`.
+    static bool fromCsvFields(const CsvField* f, size_t n, Transaction& t, CategoryRepository* catRepo,
+                              std::chrono::system_clock::time_point fallbackDate) {
+        if (n < 6) return false;
+        t.txnId = f[0].str();
+        if (!parseCsvDecimal(f[1], t.amount)) t.amount = 0;
+        long long epoch = 0;
+        t.date = parseCsvInt(f[2], epoch) ? std::chrono::system_clock::from_time_t(static_cast<std::time_t>(epoch)) : fallbackDate;
+        t.merchant = f[3].str();
+        if (catRepo && !f[4].raw.empty()) {
+            auto c = catRepo->findByName(f[4].str());
+            if (c) t.category = c;
+        }
+        t.notes = f[5].str();
+        if (n >= 8) {
+            t.userId = f[6].str();
+            t.accountId = f[7].str();
         }
+        return true;
     }
 
     // Load transactions from CSV. If catRepo != nullptr, try to resolve category names.
-    void loadFromCsv(const std::string& path, CategoryRepository* catRepo=nullptr) {
-        std::ifstream ifs(path);
-        if (!ifs) return;
-        std::string line;
-        while (std::getline(ifs, line)) {
-            if (line.empty()) continue;
-            std::vector<std::string> parts = splitCsvLine(line);
-            if (parts.size() < 6) continue;
+    // The file is memory-mapped and parsed in newline-aligned chunks on all cores. With a
+    // dedup policy, rows repeating stored ones are handled as by saveBatch; returns how many
+    // there were.
+    size_t loadFromCsv(const std::string& path, CategoryRepository* catRepo=nullptr, const DedupOptions& dedup = {}) {
+        LEDGER_PROBE(LoadFromCsv);
+        MappedFile file(path);
+        if (!file.isOpen()) return 0;
+        const auto now = std::chrono::system_clock::now();
+        auto parsed = parseCsvParallel<Transaction>(file.begin(), file.end(),
+            [&](const CsvRecord& f, size_t n, Transaction& t) { return fromCsvFields(f.data(), n, t, catRepo, now); });
+        LEDGER_COUNT(BytesRead, file.size());
+        LEDGER_COUNT(RowsLoaded, parsed.size());
+        if (dedup.policy == DuplicatePolicy::Allow) {
+            loadRows(std::move(parsed));
+            return 0;
+        }
+        return appendUnique(parsed, dedup, nullptr);
+    }
+
+    // Bulk append for loaders (CSV, binary snapshot). Not reported to the listener. The
+    // Transactions are copied into repository storage and released.
+    void loadRows(std::vector<Transaction>&& batch) {
+        appendRows(batch);
+        std::vector<Transaction>().swap(batch);
+    }
+
+    // Load straight from columns (a SnapshotReader, see loadSnapshot) without building
+    // Transactions: row i is cols.amount(i), cols.epochs()[i], cats[cols.categoryIds()[i]] (none
+    // for -1 or a null entry) and cols' string accessors. Strings are copied once, into the
+    // repository's own text; the columns need not outlive the call.
+    template <class Columns>
+    void loadColumns(const Columns& cols, const std::vector<std::shared_ptr<Category>>& cats) {
+        const size_t n = cols.size();
+        const int64_t* epochs = cols.epochs();
+        const int32_t* catIds = cols.categoryIds();
+        std::vector<int32_t> slots(cats.size(), 0);
+        for (size_t c = 0; c < cats.size(); ++c) {
             Transaction t;
-            t.txnId = unescapeCsv(parts[0]);
-            try { t.amount = std::stod(parts[1]); } catch(...) { t.amount = 0; }
-            try { std::time_t tt = static_cast<std::time_t>(std::stoll(parts[2])); t.date = std::chrono::system_clock::from_time_t(tt); } catch(...) { t.date = std::chrono::system_clock::now(); }
-            t.merchant = unescapeCsv(parts[3]);
-            std::string catName = unescapeCsv(parts[4]);
-            if (catRepo && !catName.empty()) {
-                auto c = catRepo->findByName(catName);
-                if (c) t.category = c;
-            }
-            t.notes = unescapeCsv(parts[5]);
-            txns.push_back(t);
+            t.category = cats[c];
+            slots[c] = slotOf(t);
+        }
+        reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            Decimal amount = cols.amount(i);
+            checkMagnitude(amount);
+            appendFields(amount, std::chrono::system_clock::from_time_t(static_cast<std::time_t>(epochs[i])), cols.txnId(i), cols.notes(i),
+                         cols.merchant(i), cols.userId(i), cols.accountId(i), catIds[i] >= 0 ? slots[static_cast<size_t>(catIds[i])] : 0);
+        }
+    }
+
+    // Throws std::overflow_error if saving every row of batch would break the magnitude bound
+    // that save() enforces row by row; stores nothing either way.
+    void checkBatch(const std::vector<Transaction>& batch) const {
+        Decimal m = magnitude;
+        for (const auto &t: batch) m += t.amount < 0 ? -t.amount : t.amount;
+    }
+
+    // Bulk save: same result as save() on every row in order.
+    void saveBatch(std::vector<Transaction>&& batch) {
+        appendRows(batch);
+        if (listener) for (auto &t: batch) listener->transactionSaved(t);
+        std::vector<Transaction>().swap(batch);
+    }
+
+    // The same with duplicate detection: each row is checked with findDuplicate against
+    // everything stored, the batch's earlier rows included. Rejected rows are neither stored
+    // nor reported to the listener; flagged ones are stored and (new row, row it repeats)
+    // appended to `flagged` when given. Returns the number of duplicates found.
+    size_t saveBatch(std::vector<Transaction>&& batch, const DedupOptions& dedup, std::vector<std::pair<uint32_t, uint32_t>>* flagged = nullptr) {
+        if (dedup.policy == DuplicatePolicy::Allow) {
+            saveBatch(std::move(batch));
+            return 0;
         }
+        size_t found = appendUnique(batch, dedup, flagged);
+        if (listener) for (auto &t: batch) listener->transactionSaved(t);
+        std::vector<Transaction>().swap(batch);
+        return found;
+    }
+
+    // Row number of a stored transaction that t repeats, or -1: same amount, same merchant
+    // up to case, spaces and punctuation, same txnId (both empty counts), dates at most
+    // `window` seconds apart. O(1 + window / 1 day) through the dedup index (dedup_index.h),
+    // which is built on first use (sealed rows included) and kept up to date from then on.
+    int64_t findDuplicate(const Transaction& t, int64_t window = 0) const {
+        updateDedupIndex();
+        return duplicateOf(t, window);
+    }
+
+    // Bring the lazily maintained indexes (date order, trigram index, and the dedup index once
+    // findDuplicate has been used) up to date. After this, const queries modify nothing until
+    // the next save, so several threads may run them at once.
+    void settle() const {
+        sortColumns();
+        updateTextIndex();
+        if (dedupInUse) updateDedupIndex();
+    }
+
+    // Make room for `more` rows in the table and its columns. Growth is geometric, so a long
+    // run of saveBatch calls reallocates only a handful of times.
+    void reserve(size_t more) {
+        size_t n = rows.size() + more;
+        if (n <= rows.capacity()) return;
+        n = std::max(n, 2 * rows.capacity());
+        rows.reserve(n);
+        rowPositions.reserve(n);
+        rowSlots.reserve(n);
+        byDateEpochs.reserve(n);
+        byDateRows.reserve(n);
+        byDateAmounts.reserve(n);
+        byDateSlots.reserve(n);
+        byDateMerchants.reserve(n);
     }
 
 private:
-    std::vector<Transaction> txns;
+    // One transaction, 48 bytes. txnId and notes sit back to back in the text arena; merchant,
+    // user and account are ids in the string pool (merchants repeat a lot); the category is the
+    // row's slot in rowSlots.
+    struct StoredRow {
+        int64_t amount;  // Decimal::raw()
+        int64_t ticks;   // date.time_since_epoch().count()
+        const char* text;
+        uint32_t idLen, notesLen;
+        uint32_t merchant, user, account;
+    };
+    std::vector<StoredRow> rows; // resident rows; row number coldRows + i is rows[i]
+    StringArena text;
+    StringPool strings;
+    // the Category object behind each slot (the one most recently saved with that name)
+    std::vector<std::shared_ptr<Category>> slotCategories{1};
+    ChangeListener* listener{nullptr};
+    // Sealed history: rows [0, coldRows) in compressed blocks, in row order (see sealBefore).
+    // Everything below covers the resident rows only.
+    std::vector<ColdBlock> cold;
+    uint32_t coldRows{0};
+    // Columnar copy of the rows, ordered by date: epoch (for binary search), row number,
+    // amount, category slot and merchant. Reports scan these contiguous arrays instead of
+    // Transactions. Late rows are appended unsorted and merged by the next query, hence mutable.
+    mutable std::vector<int64_t> byDateEpochs;
+    mutable std::vector<uint32_t> byDateRows;
+    mutable std::vector<int64_t> byDateAmounts; // Decimal::raw()
+    mutable std::vector<int32_t> byDateSlots;
+    mutable std::vector<uint32_t> byDateMerchants;
+    mutable size_t sortedPrefix{0};
+    // per resident row (insertion order): its position in the date-ordered columns and its slot
+    mutable std::vector<uint32_t> rowPositions;
+    std::vector<int32_t> rowSlots;
+    // posting lists: row numbers of every resident transaction in a category slot, ascending
+    std::vector<std::vector<uint32_t>> postings{1};
+    // trigram index over merchant and notes, covering resident rows [0, textIndexed). Rows are
+    // indexed when first searched after save/load; only text is indexed, so clearCategory leaves
+    // it be.
+    mutable NgramIndex textIndex;
+    mutable size_t textIndexed{0};
+    // dedup keys of rows [0, dedupIndexed) (sealed ones too), built by the first findDuplicate
+    mutable DedupIndex dedupIndex;
+    mutable uint32_t dedupIndexed{0};
+    mutable bool dedupInUse{false};
+    mutable std::vector<uint64_t> merchantHashes; // merchantDedupHash by string id, 0 = not yet
+
+    uint64_t merchantHashOf(uint32_t id) const {
+        if (id >= merchantHashes.size()) merchantHashes.resize(std::max<size_t>(id + 1, 2 * merchantHashes.size()), 0);
+        if (merchantHashes[id] == 0) merchantHashes[id] = merchantDedupHash(strings[id]);
+        return merchantHashes[id];
+    }
+
+    void updateTextIndex() const {
+        for (; textIndexed < rows.size(); ++textIndexed) {
+            const StoredRow& r = rows[textIndexed];
+            uint32_t row = coldRows + static_cast<uint32_t>(textIndexed);
+            textIndex.add(row, strings[r.merchant]);
+            textIndex.add(row, std::string_view(r.text + r.idLen, r.notesLen));
+        }
+    }
+
+    void updateDedupIndex() const {
+        dedupInUse = true;
+        if (dedupIndexed < coldRows) {
+            for (auto &block: cold) {
+                if (block.firstRow() + block.size() <= dedupIndexed) continue;
+                block.forEach([&](uint32_t row, const ColdRow& r) {
+                    if (row >= dedupIndexed) dedupIndex.add(dedupKey(r.amount, merchantHashOf(r.merchant), r.txnId, dedupDay(r.epoch())), row);
+                });
+            }
+            dedupIndexed = coldRows;
+        }
+        for (; dedupIndexed - coldRows < rows.size(); ++dedupIndexed) {
+            const StoredRow& r = rows[dedupIndexed - coldRows];
+            dedupIndex.add(dedupKey(r.amount, merchantHashOf(r.merchant), std::string_view(r.text, r.idLen), dedupDay(toEpoch(dateOf(r)))), dedupIndexed);
+        }
+    }
+
+    // findDuplicate on an up-to-date index; ownKey receives t's own dedup key
+    int64_t duplicateOf(const Transaction& t, int64_t window, uint64_t* ownKey = nullptr) const {
+        window = std::max<int64_t>(window, 0);
+        const int64_t epoch = toEpoch(t.date);
+        const uint64_t merchant = merchantDedupHash(t.merchant);
+        if (ownKey) *ownKey = dedupKey(t.amount.raw(), merchant, t.txnId, dedupDay(epoch));
+        int64_t found = -1;
+        auto same = [&](uint32_t row) {
+            int64_t amount, e;
+            uint32_t m;
+            std::string_view id;
+            if (row < coldRows) {
+                const ColdBlock& block = blockOf(row);
+                ColdRow r = block.row(row - block.firstRow());
+                amount = r.amount; e = r.epoch(); m = r.merchant; id = r.txnId;
+            } else {
+                const StoredRow& r = rows[row - coldRows];
+                amount = r.amount; e = toEpoch(dateOf(r)); m = r.merchant; id = std::string_view(r.text, r.idLen);
+            }
+            if (amount != t.amount.raw() || id != t.txnId || (e > epoch ? e - epoch : epoch - e) > window ||
+                merchantHashOf(m) != merchant) return false;
+            found = row;
+            return true;
+        };
+        for (int64_t day = dedupDay(epoch - window); day <= dedupDay(epoch + window); ++day) {
+            if (dedupIndex.find(dedupKey(t.amount.raw(), merchant, t.txnId, day), same)) break;
+        }
+        return found;
+    }
+
+    // Append the rows of batch that are not duplicates under dedup (see saveBatch) and drop
+    // the rejected ones from it. Returns the number of duplicates.
+    size_t appendUnique(std::vector<Transaction>& batch, const DedupOptions& dedup, std::vector<std::pair<uint32_t, uint32_t>>* flagged) {
+        reserve(batch.size());
+        updateDedupIndex();
+        size_t kept = 0, found = 0;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            uint64_t key;
+            int64_t dup = duplicateOf(batch[i], dedup.window, &key);
+            if (dup >= 0) {
+                ++found;
+                if (dedup.policy == DuplicatePolicy::Reject) continue;
+                if (flagged) flagged->emplace_back(dedupIndexed, static_cast<uint32_t>(dup));
+            }
+            append(batch[i]);
+            dedupIndex.add(key, dedupIndexed++);
+            if (kept != i) batch[kept] = std::move(batch[i]);
+            ++kept;
+        }
+        batch.resize(kept);
+        return found;
+    }
+
+    const ColdBlock& blockOf(uint32_t row) const {
+        auto it = std::upper_bound(cold.begin(), cold.end(), row, [](uint32_t r, const ColdBlock& b) { return r < b.firstRow(); });
+        return *(it - 1);
+    }
+
+    TxnRef refOf(const ColdRow& r) const {
+        TxnRef t;
+        t.txnId = r.txnId;
+        t.amount = Decimal::fromRaw(r.amount);
+        t.date = std::chrono::system_clock::time_point(std::chrono::system_clock::duration(r.ticks));
+        t.merchant = strings[r.merchant];
+        const auto &owner = slotCategories[static_cast<size_t>(r.slot)];
+        if (owner) { t.category = owner.get(); t.owner = &owner; }
+        t.notes = r.notes;
+        t.userId = strings[r.user];
+        t.accountId = strings[r.account];
+        return t;
+    }
+
+    // Scratch columns for a decoded block, see scanColumns.
+    struct ColumnBuffer {
+        std::vector<int64_t> epochs, amounts;
+        std::vector<int32_t> slots;
+        std::vector<uint32_t> rows, merchants;
+        void clear() { epochs.clear(); amounts.clear(); slots.clear(); rows.clear(); merchants.clear(); }
+        void push(uint32_t row, const ColdRow& r) {
+            epochs.push_back(r.epoch());
+            amounts.push_back(r.amount);
+            slots.push_back(r.slot);
+            rows.push_back(row);
+            merchants.push_back(r.merchant);
+        }
+        ColumnSlice slice() const { return {epochs.data(), amounts.data(), slots.data(), rows.size(), rows.data(), merchants.data()}; }
+    };
+
+    // Sum of |amount| over every row. Every aggregate below, and any column sum in simd.h, is
+    // a sum over a subset of the rows, so refusing rows that would take this past int64 keeps
+    // all of them in range, including the unchecked adds of the day trees.
+    Decimal magnitude{0};
+    // Throws std::overflow_error if one more row of this amount would break that bound.
+    void checkMagnitude(Decimal amount) const { static_cast<void>(magnitude + (amount < 0 ? -amount : amount)); }
+
+    // aggregates: running balance, income/expense per month, |amount| per slot per month
+    Decimal runningBalance{0};
+    std::map<int, IncomeExpense> monthTotals;
+    std::vector<std::map<int, Decimal>> slotMonths{1};
+    // the same per day, in Fenwick trees for arbitrary ranges: income, expense, then |amount|
+    // and row count for every slot
+    DayTotals dayTotals{4};
+    // and |amount| quantiles per slot
+    std::vector<QuantileSketch> slotSketches{1};
+    static size_t absSeries(size_t slot) { return 2 + 2 * slot; }
+
+    // Add sign * (sum of series [first, first + n) over the rows dated before x) into out.
+    // Whole days come from the trees; the rows of x's own day are scanned from whichever end
+    // of the day is nearer to x. Needs sorted columns.
+    void addPrefix(int64_t x, int64_t sign, int64_t* out, size_t first, size_t n) const {
+        int64_t day = DayTotals::dayOf(x), start = DayTotals::dayStart(day);
+        auto lo = std::lower_bound(byDateEpochs.begin(), byDateEpochs.end(), start);
+        auto mid = std::lower_bound(lo, byDateEpochs.end(), x);
+        auto hi = std::lower_bound(mid, byDateEpochs.end(), DayTotals::dayStart(day + 1));
+        bool fromStart = mid - lo <= hi - mid;
+        for (size_t s = 0; s < n; ++s) out[s] += sign * dayTotals.prefix(first + s, fromStart ? day : day + 1);
+        // rows in [start, x) are added, or rows in [x, next day) taken off
+        int64_t k = fromStart ? sign : -sign;
+        auto addRow = [&](int64_t a, int32_t slot) {
+            size_t series[3] = {a >= 0 ? size_t(0) : size_t(1), absSeries(static_cast<size_t>(slot)), 0};
+            series[2] = series[1] + 1;
+            int64_t values[3] = {a >= 0 ? a : -a, a >= 0 ? a : -a, 1};
+            for (int j = 0; j < 3; ++j) {
+                if (series[j] - first < n) out[series[j] - first] += k * values[j]; // wraps below first
+            }
+        };
+        size_t b = static_cast<size_t>((fromStart ? lo : mid) - byDateEpochs.begin());
+        size_t e = static_cast<size_t>((fromStart ? mid : hi) - byDateEpochs.begin());
+        LEDGER_COUNT(RowsScanned, e - b);
+        for (size_t i = b; i < e; ++i) addRow(byDateAmounts[i], byDateSlots[i]);
+        // sealed rows of the same stretch, from the blocks whose zone maps overlap it
+        int64_t from = fromStart ? start : x, to = fromStart ? x : DayTotals::dayStart(day + 1);
+        for (auto &block: cold) block.forEachIn(from, to, [&](uint32_t, const ColdRow& r) { addRow(r.amount, r.slot); });
+    }
+
+    static std::chrono::system_clock::time_point dateOf(const StoredRow& r) {
+        return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(r.ticks));
+    }
+
+    void appendRows(const std::vector<Transaction>& batch) {
+        reserve(batch.size());
+        for (auto &t: batch) append(t);
+    }
+
+    // Store one row, then index and aggregate it. Rows arriving in date order extend the
+    // sorted prefix of the columns; anything else is merged in by the next query (see sortColumns).
+    void append(const Transaction& t) {
+        checkMagnitude(t.amount); // throws before anything is stored
+        appendFields(t.amount, t.date, t.txnId, t.notes, t.merchant, t.userId, t.accountId, slotOf(t));
+    }
+
+    // The same from the row's fields, once the amount has passed checkMagnitude.
+    void appendFields(Decimal amount, std::chrono::system_clock::time_point date, std::string_view txnId, std::string_view notes,
+                      std::string_view merchant, std::string_view userId, std::string_view accountId, int32_t slot) {
+        const uint32_t row = coldRows + static_cast<uint32_t>(rows.size());
+        StoredRow r;
+        r.amount = amount.raw();
+        r.ticks = static_cast<int64_t>(date.time_since_epoch().count());
+        r.idLen = static_cast<uint32_t>(txnId.size());
+        r.notesLen = static_cast<uint32_t>(notes.size());
+        char* at = text.allocate(txnId.size() + notes.size());
+        if (at) {
+            std::memcpy(at, txnId.data(), txnId.size());
+            std::memcpy(at + txnId.size(), notes.data(), notes.size());
+        }
+        r.text = at;
+        r.merchant = strings.intern(merchant);
+        r.user = strings.intern(userId);
+        r.account = strings.intern(accountId);
+        rows.push_back(r);
+
+        int64_t e = toEpoch(date);
+        if (sortedPrefix == byDateEpochs.size() && (byDateEpochs.empty() || e >= byDateEpochs.back())) ++sortedPrefix;
+        rowPositions.push_back(static_cast<uint32_t>(byDateEpochs.size()));
+        rowSlots.push_back(slot);
+        postings[static_cast<size_t>(slot)].push_back(row);
+        byDateEpochs.push_back(e);
+        byDateRows.push_back(row);
+        byDateAmounts.push_back(r.amount);
+        byDateSlots.push_back(slot);
+        byDateMerchants.push_back(r.merchant);
+        aggregate(e, amount, slot);
+    }
+
+    void aggregate(int64_t epoch, Decimal amount, int32_t slot) {
+        magnitude += amount < 0 ? -amount : amount; // the only step that can throw
+        int key = MonthTable::instance().keyOf(epoch);
+        runningBalance += amount;
+        auto &m = monthTotals[key];
+        if (amount >= 0) m.income += amount;
+        else m.expense += -amount;
+        if (static_cast<size_t>(slot) >= slotMonths.size()) slotMonths.resize(static_cast<size_t>(slot) + 1);
+        slotMonths[static_cast<size_t>(slot)][key] += amount < 0 ? -amount : amount;
+        int64_t day = DayTotals::dayOf(epoch), raw = amount.raw();
+        size_t series = absSeries(static_cast<size_t>(slot));
+        if (series + 2 > dayTotals.seriesCount()) dayTotals.setSeriesCount(series + 2);
+        dayTotals.add(raw >= 0 ? 0 : 1, day, raw >= 0 ? raw : -raw);
+        dayTotals.add(series, day, raw >= 0 ? raw : -raw);
+        dayTotals.add(series + 1, day, 1);
+        if (static_cast<size_t>(slot) >= slotSketches.size()) slotSketches.resize(static_cast<size_t>(slot) + 1);
+        slotSketches[static_cast<size_t>(slot)].add(raw >= 0 ? raw : -raw);
+    }
+
+    // Restore date order: sort the unsorted tail and merge it with the sorted prefix,
+    // O(n + k log k) for k late rows. Ties keep insertion order.
+    void sortColumns() const {
+        if (sortedPrefix == byDateEpochs.size()) return;
+        std::vector<uint32_t> order(byDateEpochs.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = static_cast<uint32_t>(i);
+        auto byEpoch = [&](uint32_t a, uint32_t b) { return byDateEpochs[a] < byDateEpochs[b]; };
+        auto mid = order.begin() + static_cast<std::ptrdiff_t>(sortedPrefix);
+        std::stable_sort(mid, order.end(), byEpoch);
+        std::inplace_merge(order.begin(), mid, order.end(), byEpoch);
+        auto permute = [&](auto& column) {
+            std::remove_reference_t<decltype(column)> sorted(column.size());
+            for (size_t i = 0; i < order.size(); ++i) sorted[i] = column[order[i]];
+            column.swap(sorted);
+        };
+        permute(byDateEpochs);
+        permute(byDateRows);
+        permute(byDateAmounts);
+        permute(byDateSlots);
+        permute(byDateMerchants);
+        for (size_t i = 0; i < byDateRows.size(); ++i) rowPositions[byDateRows[i] - coldRows] = static_cast<uint32_t>(i);
+        sortedPrefix = byDateEpochs.size();
+    }
+
+    // Category slot for a transaction: 0 = uncategorized, otherwise the interned category id + 1.
+    // Categories that never went through a CategoryRepository are interned on first sight
+    // (callers sharing them across threads stamp them first, see ShardedTransactionRepository).
+    int32_t slotOf(const Transaction& t) {
+        if (!t.category) return 0;
+        if (t.category->id < 0) CategoryRepository::stampIds(&t, 1);
+        size_t slot = static_cast<size_t>(t.category->id) + 1;
+        if (slot >= postings.size()) {
+            postings.resize(slot + 1);
+            slotMonths.resize(slot + 1);
+            slotSketches.resize(slot + 1);
+            slotCategories.resize(slot + 1);
+        }
+        if (slotCategories[slot] != t.category) slotCategories[slot] = t.category;
+        return static_cast<int32_t>(slot);
+    }
+
+    static int32_t slotForName(const std::string& name) {
+        int id = CategoryRepository::idOf(name);
+        return id < 0 ? -1 : id + 1;
+    }
 
     // CSV helpers moved to file-scope above
 };
 
+inline TxnRef TxnView::operator[](size_t i) const { return repo->ref(rowNumber(i)); }
+inline const TxnRef& TxnView::iterator::operator*() const { return current = (*view)[pos]; }
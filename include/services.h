@@ -1,13 +1,19 @@
 #pragma once
 #include "models.h"
 #include "repositories.h"
+#include "matcher.h"
+#include "classifier.h"
+#include "import_pipeline.h"
 #include <string>
 #include <map>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <ctime>
+#include <vector>
 
-// Simple keyword-based categorizer - stub for ML
+// Suggests a category for a transaction: explicit keyword rules first, then a naive Bayes model
+// (classifier.h) learned from the transactions that already have a category.
 class CategorizerService {
 public:
     CategorizerService(CategoryRepository& repo): catRepo(repo) {
@@ -15,38 +21,146 @@ public:
     if (!catRepo.findByName("Food")) { Category food{"c_food","Food",CategoryType::Expense}; catRepo.save(food); }
     if (!catRepo.findByName("Transport")) { Category transport{"c_trans","Transport",CategoryType::Expense}; catRepo.save(transport); }
     if (!catRepo.findByName("Salary")) { Category salary{"c_salary","Salary",CategoryType::Income}; catRepo.save(salary); }
-    // simple keyword map (ASCII keywords)
-    keywordToCategory["eat"] = "Food";
-    keywordToCategory["meal"] = "Food";
-    keywordToCategory["lunch"] = "Food";
-    keywordToCategory["subway"] = "Transport";
-    keywordToCategory["bus"] = "Transport";
-    keywordToCategory["salary"] = "Salary";
+    // default keyword rules
+    addRule("eat", "Food");
+    addRule("meal", "Food");
+    addRule("lunch", "Food");
+    addRule("subway", "Transport");
+    addRule("bus", "Transport");
+    addRule("salary", "Salary");
     }
 
-    // returns pair<categoryPtr, confidence(0..1)>
+    // Keywords match case-insensitively anywhere in merchant or notes. The highest priority
+    // wins; on equal priority a merchant hit beats a notes hit, then the older rule wins.
+    // Adding an existing keyword again replaces its category and priority.
+    void addRule(const std::string& keyword, const std::string& categoryName, int priority = 0) {
+        int rule = matcher.add(keyword, priority);
+        if (rule < 0) return;
+        if (static_cast<size_t>(rule) >= targetNames.size()) targetNames.resize(static_cast<size_t>(rule) + 1);
+        targetNames[static_cast<size_t>(rule)] = categoryName;
+        resolvedGeneration = kUnresolved;
+    }
+
+    bool removeRule(const std::string& keyword) { return matcher.remove(keyword) >= 0; }
+
+    // Resolve rule targets and build the matcher up front. After this autoCategorize may be
+    // called from several threads at once, as long as rules and categories stay unchanged.
+    void prepare() {
+        resolveTargets();
+        matcher.build();
+    }
+
+    // Train the model from scratch on every categorized transaction in the repository.
+    void train(const TransactionRepository& txns) {
+        LEDGER_PROBE(TrainCategorizer);
+        struct Example { std::string_view merchant, notes; int32_t label; };
+        std::vector<Example> examples;
+        model = NaiveBayesModel();
+        txns.forEach([&](const TxnRef& t) {
+            if (t.category) examples.push_back({t.merchant, t.notes, model.label(t.category->name)});
+        });
+        model.train(examples);
+        resolvedGeneration = kUnresolved;
+    }
+
+    // Incremental updates: a transaction saved with a category, one whose category is taken
+    // back, or one moved from `before` to its current category. Row is a Transaction or a TxnRef.
+    template <class Row>
+    void learn(const Row& t) {
+        if (!t.category) return;
+        model.learn(t.merchant, t.notes, model.label(t.category->name));
+        resolvedGeneration = kUnresolved;
+    }
+    void forget(const Transaction& t) {
+        int32_t label = t.category ? model.findLabel(t.category->name) : -1;
+        if (label >= 0) model.forget(t.merchant, t.notes, label);
+    }
+    void recategorized(const Transaction& t, const std::shared_ptr<Category>& before) {
+        Transaction old = t;
+        old.category = before;
+        forget(old);
+        learn(t);
+    }
+
+    // returns pair<categoryPtr, confidence(0..1)>: a rule hit is certain (1.0); otherwise the
+    // model's posterior for its best label, or {nullptr, 0} when it knows nothing relevant.
     std::pair<std::shared_ptr<Category>, double> autoCategorize(const Transaction& t) {
-        for (auto &kv: keywordToCategory) {
-            if (t.merchant.find(kv.first) != std::string::npos || t.notes.find(kv.first) != std::string::npos) {
-                auto c = catRepo.findByName(kv.second);
-                if (c) return {c, 0.95};
-            }
+        LEDGER_PROBE(AutoCategorize);
+        resolveTargets();
+        int rule = bestRule(t);
+        if (rule >= 0) return {targets[static_cast<size_t>(rule)], 1.0};
+        thread_local NaiveBayesModel::Scratch scratch;
+        auto p = model.predict(t.merchant, t.notes, scratch, labelEnabled.data());
+        if (p.label < 0) return {nullptr, 0.0};
+        return {labelTargets[static_cast<size_t>(p.label)], p.confidence};
+    }
+
+    // The same for many transactions; the rows without a rule hit go through the model in
+    // one batch. Same threading rules as autoCategorize.
+    std::vector<std::pair<std::shared_ptr<Category>, double>> autoCategorizeBatch(const std::vector<const Transaction*>& rows) {
+        LEDGER_PROBE(AutoCategorizeBatch);
+        resolveTargets();
+        std::vector<std::pair<std::shared_ptr<Category>, double>> out(rows.size());
+        std::vector<size_t> rest;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            int rule = bestRule(*rows[i]);
+            if (rule >= 0) out[i] = {targets[static_cast<size_t>(rule)], 1.0};
+            else rest.push_back(i);
+        }
+        thread_local NaiveBayesModel::Scratch scratch;
+        std::vector<NaiveBayesModel::Prediction> predicted(rest.size());
+        model.predictBatch(rest.size(), [&](size_t i) -> const Transaction& { return *rows[rest[i]]; }, predicted.data(), scratch, labelEnabled.data());
+        for (size_t i = 0; i < rest.size(); ++i) {
+            if (predicted[i].label >= 0) out[rest[i]] = {labelTargets[static_cast<size_t>(predicted[i].label)], predicted[i].confidence};
         }
-        return {nullptr, 0.0};
+        return out;
     }
 
+    const NaiveBayesModel& categoryModel() const { return model; }
+
 private:
+    static constexpr uint64_t kUnresolved = ~uint64_t(0);
     CategoryRepository& catRepo;
-    std::map<std::string,std::string> keywordToCategory;
+    KeywordMatcher matcher;
+    std::vector<std::string> targetNames; // by rule id
+    std::vector<std::shared_ptr<Category>> targets;
+    NaiveBayesModel model;
+    std::vector<std::shared_ptr<Category>> labelTargets; // by model label
+    std::vector<uint8_t> labelEnabled;
+    uint64_t resolvedGeneration{kUnresolved};
+
+    // Look every rule's and label's category up once per category change rather than once per
+    // hit; rules and labels whose category does not exist are disabled so the next best one
+    // can match instead.
+    void resolveTargets() {
+        if (resolvedGeneration == catRepo.generation()) return;
+        targets.assign(targetNames.size(), nullptr);
+        for (size_t r = 0; r < targetNames.size(); ++r) {
+            targets[r] = catRepo.findByName(targetNames[r]);
+            matcher.setEnabled(static_cast<int>(r), targets[r] != nullptr);
+        }
+        labelTargets.assign(model.labelCount(), nullptr);
+        labelEnabled.assign(model.labelCount() + 1, 0);
+        for (size_t l = 0; l < model.labelCount(); ++l) {
+            labelTargets[l] = catRepo.findByName(model.labelName(l));
+            labelEnabled[l] = labelTargets[l] != nullptr;
+        }
+        resolvedGeneration = catRepo.generation();
+    }
+
+    int bestRule(const Transaction& t) const {
+        int best = matcher.bestMatch(t.merchant);
+        int fromNotes = matcher.bestMatch(t.notes);
+        if (fromNotes >= 0 && (best < 0 || matcher.priority(fromNotes) > matcher.priority(best))) best = fromNotes;
+        return best;
+    }
 };
 
 class BalanceService {
 public:
     BalanceService(TransactionRepository& r): repo(r) {}
     Decimal calculateBalance() const {
-        Decimal s = 0;
-        for (auto &t: repo.findAll()) s += t.amount;
-        return s;
+        return repo.balance();
     }
 private:
     TransactionRepository& repo;
@@ -58,88 +172,84 @@ public:
 
     // simple category breakdown for given year/month
     std::map<std::string, Decimal> categoryBreakdown(int year, int month) {
-        std::map<std::string, Decimal> out;
-        auto txns = repo.findByUserAndMonth("", year, month);
-        for (auto &t: txns) {
-            std::string name = t.category ? t.category->name : "Uncategorized";
-            out[name] += t.amount < 0 ? -t.amount : t.amount;
-        }
-        return out;
+        LEDGER_PROBE(CategoryBreakdown);
+        int key = monthKey(year, month);
+        return repo.categoryTotals(key, key + 1);
     }
 
     void printCategoryChart(int year, int month) {
-        auto map = categoryBreakdown(year, month);
-        Decimal total = 0; for (auto &kv: map) total += kv.second;
-        std::cout << "Category breakdown for " << year << "-" << std::setw(2) << std::setfill('0') << month << '\n';
-        for (auto &kv: map) {
-            int pct = total>0 ? int((kv.second/total)*100) : 0;
-            int bars = pct/2;
-            std::cout << std::setw(12) << std::left << kv.first << " ";
-            for (int i=0;i<bars;i++) std::cout<<"#";
-            std::cout << " " << kv.second << " (" << pct << "% )\n";
-        }
-        std::cout << "Total: " << total << '\n';
+        std::ostringstream title;
+        title << "Category breakdown for " << year << "-" << std::setw(2) << std::setfill('0') << month;
+        printChart(title.str(), categoryBreakdown(year, month));
+    }
+
+    // Chart for an arbitrary [from, to) epoch range, e.g. a custom quarter.
+    void printCategoryChartRange(int64_t from, int64_t to) {
+        printChart("Category breakdown for " + formatDay(from) + " to " + formatDay(to) + " (exclusive)", categoryBreakdownRange(from, to));
+    }
+
+    // Chart for the last `days` days, today included.
+    void printCategoryChartLastDays(int days) {
+        int64_t now = static_cast<int64_t>(std::time(nullptr));
+        int64_t from = localDayStart(now, 1 - days), to = localDayStart(now, 1);
+        printChart("Category breakdown for the last " + std::to_string(days) + " days", categoryBreakdownRange(from, to));
     }
 
     // income and expense totals for a specific month (year, month)
     std::pair<Decimal, Decimal> incomeExpenseTotalsMonth(int year, int month) {
-        Decimal income = 0, expense = 0;
-        auto txns = repo.findByUserAndMonth("", year, month);
-        for (auto &t: txns) {
-            if (t.amount >= 0) income += t.amount;
-            else expense += -t.amount;
-        }
-        return {income, expense};
+        LEDGER_PROBE(IncomeExpenseMonth);
+        int key = monthKey(year, month);
+        auto totals = repo.incomeExpense(key, key + 1);
+        return {totals.income, totals.expense};
     }
 
     // income and expense totals for a specific year
     std::pair<Decimal, Decimal> incomeExpenseTotalsYear(int year) {
-        Decimal income = 0, expense = 0;
-        for (auto &t: repo.findAll()) {
-            auto tt = std::chrono::system_clock::to_time_t(t.date);
-            tm local;
-#ifdef _WIN32
-            localtime_s(&local, &tt);
-#else
-            localtime_r(&tt, &local);
-#endif
-            if (local.tm_year + 1900 == year) {
-                if (t.amount >= 0) income += t.amount;
-                else expense += -t.amount;
-            }
-        }
-        return {income, expense};
+        LEDGER_PROBE(IncomeExpenseYear);
+        auto totals = repo.incomeExpense(monthKey(year, 1), monthKey(year + 1, 1));
+        return {totals.income, totals.expense};
     }
 
     // category breakdown for a full year
     std::map<std::string, Decimal> categoryBreakdownYear(int year) {
-        std::map<std::string, Decimal> out;
-        for (auto &t: repo.findAll()) {
-            auto tt = std::chrono::system_clock::to_time_t(t.date);
-            tm local;
-#ifdef _WIN32
-            localtime_s(&local, &tt);
-#else
-            localtime_r(&tt, &local);
-#endif
-            if (local.tm_year + 1900 == year) {
-                std::string name = t.category ? t.category->name : "Uncategorized";
-                out[name] += t.amount < 0 ? -t.amount : t.amount;
-            }
-        }
-        return out;
+        LEDGER_PROBE(CategoryBreakdownYear);
+        return repo.categoryTotals(monthKey(year, 1), monthKey(year + 1, 1));
     }
 
     // category breakdown for all time
     std::map<std::string, Decimal> categoryBreakdownAll() {
-        std::map<std::string, Decimal> out;
-        for (auto &t: repo.findAll()) {
-            std::string name = t.category ? t.category->name : "Uncategorized";
-            out[name] += t.amount < 0 ? -t.amount : t.amount;
-        }
+        LEDGER_PROBE(CategoryBreakdownAll);
+        return repo.categoryTotalsAll();
+    }
+
+    // income and expense totals for an arbitrary [from, to) epoch range, O(log days) from
+    // the repository's daily prefix sums
+    std::pair<Decimal, Decimal> incomeExpenseTotalsRange(int64_t from, int64_t to) {
+        LEDGER_PROBE(IncomeExpenseRange);
+        auto totals = repo.incomeExpenseBetween(from, to);
+        return {totals.income, totals.expense};
+    }
+
+    // category breakdown for an arbitrary [from, to) epoch range
+    std::map<std::string, Decimal> categoryBreakdownRange(int64_t from, int64_t to) {
+        LEDGER_PROBE(CategoryBreakdownRange);
+        return repo.categoryTotalsBetween(from, to);
+    }
+
+    // Income/expense per day (stepDays = 1), week (7), ... for `points` consecutive periods,
+    // the first starting at the local midnight of `from`; for charts.
+    std::vector<std::pair<Decimal, Decimal>> incomeExpenseSeries(int64_t from, size_t points, int stepDays = 1) {
+        LEDGER_PROBE(IncomeExpenseSeries);
+        std::vector<std::pair<Decimal, Decimal>> out;
+        for (auto &p: repo.incomeExpenseSeries(periodBounds(from, points, stepDays))) out.emplace_back(p.income, p.expense);
         return out;
     }
 
+    // |amount| of one category over the same periods.
+    std::vector<Decimal> categorySeries(const std::string& category, int64_t from, size_t points, int stepDays = 1) {
+        return repo.categorySeries(category, periodBounds(from, points, stepDays));
+    }
+
     void printCategorySummaryYear(int year) {
         auto map = categoryBreakdownYear(year);
         Decimal total = 0; for (auto &kv: map) total += kv.second;
@@ -158,6 +268,39 @@ public:
 
 private:
     TransactionRepository& repo;
+
+    static void printChart(const std::string& title, const std::map<std::string, Decimal>& map) {
+        Decimal total = 0; for (auto &kv: map) total += kv.second;
+        std::cout << title << '\n';
+        for (auto &kv: map) {
+            int pct = total>0 ? int((kv.second/total)*100) : 0;
+            int bars = pct/2;
+            std::cout << std::setw(12) << std::left << kv.first << " ";
+            for (int i=0;i<bars;i++) std::cout<<"#";
+            std::cout << " " << kv.second << " (" << pct << "% )\n";
+        }
+        std::cout << "Total: " << total << '\n';
+    }
+
+    static std::vector<int64_t> periodBounds(int64_t from, size_t points, int stepDays) {
+        std::vector<int64_t> bounds;
+        for (size_t i = 0; i <= points; ++i) bounds.push_back(localDayStart(from, static_cast<int>(i) * stepDays));
+        return bounds;
+    }
+
+    // "2025-11-03" (local date)
+    static std::string formatDay(int64_t epoch) {
+        std::time_t tt = static_cast<std::time_t>(epoch);
+        tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &tt);
+#else
+        localtime_r(&tt, &local);
+#endif
+        char buf[16];
+        std::strftime(buf, sizeof buf, "%Y-%m-%d", &local);
+        return buf;
+    }
 };
 
 class TransactionService {
@@ -165,36 +308,93 @@ public:
     TransactionService(TransactionRepository& r, CategoryRepository& cr, CategorizerService& cat, BalanceService& b)
     : repo(r), catRepo(cr), categorizer(cat), balanceSvc(b) {}
 
-    // import and auto-categorize
-    void importTransactions(std::vector<Transaction> txns, double confidenceThreshold=0.8) {
-        for (auto &t : txns) {
-            auto res = categorizer.autoCategorize(t);
-            Transaction copy = t;
-            if (res.first && res.second>=confidenceThreshold) {
-                copy.category = res.first;
-            } else {
-                // leave uncategorized (needs review) for demo
-            }
-            repo.save(copy);
-        }
+    // import and auto-categorize, through the bulk import pipeline (import_pipeline.h)
+    ImportStats importTransactions(std::vector<Transaction> txns, double confidenceThreshold=0.8, const ImportOptions& opt = {}) {
+        LEDGER_PROBE(ImportTransactions);
+        categorizer.prepare();
+        size_t before = repo.size();
+        ImportStats stats;
+        try {
+            stats = importRows(repo, std::move(txns), CategorizeAbove{categorizer, confidenceThreshold, true}, opt);
+        } catch (...) { learnStored(before); throw; }
+        learnStored(before);
+        return stats;
+    }
+
+    // Stream a statement file in the transactions.csv layout. Rows that name a known
+    // category keep it; the rest go through the categorizer.
+    ImportStats importFromCsv(const std::string& path, double confidenceThreshold=0.8, const ImportOptions& opt = {}) {
+        LEDGER_PROBE(ImportFromCsv);
+        categorizer.prepare();
+        size_t before = repo.size();
+        ImportStats stats;
+        try {
+            stats = importCsvFile(repo, path, &catRepo, CategorizeAbove{categorizer, confidenceThreshold, false}, opt);
+        } catch (...) { learnStored(before); throw; }
+        learnStored(before);
+        return stats;
     }
 
     void addTransaction(const Transaction& t) {
         repo.save(t);
+        categorizer.learn(t);
+    }
+
+    // Move a category's transactions to Uncategorized (after the category itself was removed)
+    // and take them back out of the categorizer's model. Returns how many rows moved.
+    size_t clearCategory(const std::string& categoryName) {
+        std::vector<Transaction> moved = repo.findByCategory(categoryName).toTransactions();
+        repo.clearCategory(categoryName);
+        for (auto &t: moved) {
+            std::shared_ptr<Category> before = std::move(t.category);
+            t.category = nullptr;
+            categorizer.recategorized(t, before);
+        }
+        return moved.size();
     }
 
 private:
     TransactionRepository& repo;
     CategoryRepository& catRepo;
     CategorizerService& categorizer;
+
+    // Every stored row is in the model (clearCategory forgets them again), imported ones too:
+    // teach it the rows stored from `from` on.
+    void learnStored(size_t from) {
+        auto rows = repo.findAll();
+        for (size_t i = from; i < rows.size(); ++i) categorizer.learn(rows[i]);
+    }
+
     BalanceService& balanceSvc;
+
+    // categorize step of the import pipeline, a batch at a time
+    struct CategorizeAbove {
+        CategorizerService& categorizer;
+        double threshold;
+        bool overrideExisting;
+        void operator()(std::vector<Transaction>& rows, std::vector<uint8_t>& assigned) const {
+            std::vector<const Transaction*> pending;
+            std::vector<size_t> at;
+            for (size_t i = 0; i < rows.size(); ++i) {
+                if (rows[i].category && !overrideExisting) continue;
+                pending.push_back(&rows[i]);
+                at.push_back(i);
+            }
+            auto res = categorizer.autoCategorizeBatch(pending);
+            for (size_t k = 0; k < res.size(); ++k) {
+                if (!res[k].first || res[k].second < threshold) continue; // leave as is (needs review)
+                rows[at[k]].category = res[k].first;
+                assigned[at[k]] = 1;
+            }
+        }
+    };
 };
 
 class SearchService {
 public:
     SearchService(TransactionRepository& r): repo(r) {}
-    std::vector<Transaction> searchByCategory(const std::string& cat) { return repo.findByCategory(cat); }
-    std::vector<Transaction> searchByKeyword(const std::string& kw) { return repo.searchByKeyword(kw); }
+    TxnView searchByCategory(const std::string& cat) { return repo.findByCategory(cat); }
+    TxnView searchByKeyword(const std::string& kw) { return repo.searchByKeyword(kw); }
 private:
     TransactionRepository& repo;
 };
@@ -0,0 +1,208 @@
+#pragma once
+#include "repositories.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Transactions of many users, partitioned into one shard per (userId, accountId).
+//
+// Every shard is a TransactionRepository of its own (rows, date columns, posting lists, text
+// index, aggregates) behind its own reader/writer lock, plus the Account whose balance it keeps
+// current. A query for one user only locks that user's shards, shared, so queries for different
+// users never wait on each other, and a save only blocks readers of the same account.
+//
+// The shard directory has a lock of its own that is taken exclusively only to create a shard.
+// Shards are never removed, so a Shard* stays valid for the repository's lifetime.
+// Category ids are stamped (CategoryRepository::stampIds) before any shard lock is taken, so
+// rows of different shards may share a Category that no CategoryRepository has interned yet.
+//
+// Saves leave a shard's lazy indexes (date order, text index) stale; the first reader after
+// them settles the shard under its exclusive lock, so a run of saves costs one settle, not one
+// per save, and writers never pay for it.
+class ShardedTransactionRepository {
+public:
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        mutable bool settled{true}; // under mutex
+        std::string userId;
+        Account account;
+        TransactionRepository repo;
+    };
+
+    void save(const Transaction& t) {
+        CategoryRepository::stampIds(&t, 1);
+        Shard& s = shardFor(t.userId, t.accountId);
+        std::unique_lock<std::shared_mutex> lk(s.mutex);
+        s.repo.save(t);
+        s.account.adjustBalance(t.amount);
+        s.settled = false;
+    }
+
+    // Rows are grouped by shard (keeping their order within each) and every shard is locked
+    // once for its whole group. All or nothing: the shards are locked (in key order, so
+    // concurrent batches cannot deadlock) and every group is checked against its shard's
+    // magnitude bound before the first row is stored, so on std::overflow_error nothing was saved.
+    void saveBatch(std::vector<Transaction>&& rows) {
+        CategoryRepository::stampIds(rows.data(), rows.size());
+        std::map<std::pair<std::string, std::string>, std::vector<Transaction>> groups;
+        for (auto &t: rows) groups[{t.userId, t.accountId}].push_back(std::move(t));
+        rows.clear();
+        std::vector<Shard*> targets;
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        for (auto &g: groups) {
+            targets.push_back(&shardFor(g.first.first, g.first.second));
+            locks.emplace_back(targets.back()->mutex);
+            targets.back()->repo.checkBatch(g.second);
+        }
+        size_t next = 0;
+        for (auto &g: groups) {
+            Shard& s = *targets[next++];
+            Decimal delta;
+            for (auto &t: g.second) delta += t.amount;
+            s.repo.saveBatch(std::move(g.second));
+            s.account.adjustBalance(delta);
+            s.settled = false;
+        }
+    }
+
+    // Run f(const TransactionRepository&) on one account's shard under its shared lock and
+    // return the result; f gets an empty repository if the account has no rows. Views returned
+    // by the repository must not outlive f.
+    template <class F>
+    auto read(const std::string& userId, const std::string& accountId, F&& f) const {
+        const Shard* s = find(userId, accountId);
+        if (!s) return f(static_cast<const TransactionRepository&>(empty));
+        auto lk = settledLock(*s);
+        return f(static_cast<const TransactionRepository&>(s->repo));
+    }
+
+    // Call f(const Shard&) for each of a user's shards, in account order, each under its
+    // shared lock.
+    template <class F>
+    void forEachShard(const std::string& userId, F&& f) const {
+        for (const Shard* s: shardsOf(userId)) {
+            auto lk = settledLock(*s);
+            f(*s);
+        }
+    }
+
+    // A user's transactions in a month, across all their accounts, in date order (copies,
+    // since the shards may change once their locks are released).
+    std::vector<Transaction> findByUserAndMonth(const std::string& userId, int year, int month) const {
+        std::vector<Transaction> out;
+        size_t sorted = 0;
+        forEachShard(userId, [&](const Shard& s) {
+            auto view = s.repo.findByUserAndMonth(std::string(), year, month);
+            out.reserve(out.size() + view.size());
+            for (const auto &t: view) out.push_back(t);
+            // each shard's rows are already in date order; merge them run by run
+            auto mid = out.begin() + static_cast<std::ptrdiff_t>(sorted);
+            std::inplace_merge(out.begin(), mid, out.end(), [](const Transaction& a, const Transaction& b) { return a.date < b.date; });
+            sorted = out.size();
+        });
+        return out;
+    }
+
+    // Accounts of a user with their current balances.
+    std::vector<Account> accounts(const std::string& userId) const {
+        std::vector<Account> out;
+        forEachShard(userId, [&](const Shard& s) { out.push_back(s.account); });
+        return out;
+    }
+
+    Decimal balance(const std::string& userId, const std::string& accountId) const {
+        const Shard* s = find(userId, accountId);
+        if (!s) return Decimal();
+        std::shared_lock<std::shared_mutex> lk(s->mutex);
+        return s->account.balance;
+    }
+
+    Decimal userBalance(const std::string& userId) const {
+        Decimal total;
+        forEachShard(userId, [&](const Shard& s) { total += s.account.balance; });
+        return total;
+    }
+
+    std::vector<std::string> users() const {
+        std::shared_lock<std::shared_mutex> lk(dirMutex);
+        std::vector<std::string> out;
+        for (auto &u: shards) out.push_back(u.first);
+        return out;
+    }
+
+    size_t shardCount() const {
+        std::shared_lock<std::shared_mutex> lk(dirMutex);
+        size_t n = 0;
+        for (auto &u: shards) n += u.second.size();
+        return n;
+    }
+
+    size_t size() const {
+        std::vector<const Shard*> all;
+        {
+            std::shared_lock<std::shared_mutex> lk(dirMutex);
+            for (auto &u: shards) for (auto &a: u.second) all.push_back(a.second.get());
+        }
+        size_t n = 0;
+        for (const Shard* s: all) {
+            std::shared_lock<std::shared_mutex> lk(s->mutex);
+            n += s->repo.size();
+        }
+        return n;
+    }
+
+private:
+    // userId -> accountId -> shard
+    std::map<std::string, std::map<std::string, std::unique_ptr<Shard>>> shards;
+    mutable std::shared_mutex dirMutex;
+    const TransactionRepository empty;
+
+    // Shared lock on a shard whose lazy indexes are up to date, settling it first if needed.
+    static std::shared_lock<std::shared_mutex> settledLock(const Shard& s) {
+        std::shared_lock<std::shared_mutex> lk(s.mutex);
+        while (!s.settled) {
+            lk.unlock();
+            {
+                std::unique_lock<std::shared_mutex> ex(s.mutex);
+                if (!s.settled) {
+                    s.repo.settle();
+                    s.settled = true;
+                }
+            }
+            lk.lock();
+        }
+        return lk;
+    }
+
+    Shard* find(const std::string& userId, const std::string& accountId) const {
+        std::shared_lock<std::shared_mutex> lk(dirMutex);
+        auto u = shards.find(userId);
+        if (u == shards.end()) return nullptr;
+        auto a = u->second.find(accountId);
+        return a == u->second.end() ? nullptr : a->second.get();
+    }
+
+    std::vector<const Shard*> shardsOf(const std::string& userId) const {
+        std::shared_lock<std::shared_mutex> lk(dirMutex);
+        std::vector<const Shard*> out;
+        auto u = shards.find(userId);
+        if (u != shards.end()) for (auto &a: u->second) out.push_back(a.second.get());
+        return out;
+    }
+
+    Shard& shardFor(const std::string& userId, const std::string& accountId) {
+        if (Shard* s = find(userId, accountId)) return *s;
+        std::unique_lock<std::shared_mutex> lk(dirMutex);
+        auto &slot = shards[userId][accountId];
+        if (!slot) {
+            slot = std::make_unique<Shard>();
+            slot->userId = userId;
+            slot->account.accountId = accountId;
+        }
+        return *slot;
+    }
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// Aggregation kernels over Decimal::raw() amount columns, such as a mapped snapshot's. An
+// AVX2 path is picked at runtime when the CPU has it; SSE2 (always present on x86-64) and
+// plain scalar code are the fallbacks.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LEDGER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(LEDGER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LEDGER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LEDGER_TARGET_AVX2
+#endif
+
+// Amounts are Decimal::raw() units. Integer addition is associative, so every path below
+// returns exactly what a serial loop would, whatever the lane count or order. Sums wrap modulo
+// 2^64 like the vector adds instead of overflowing; over a repository's columns they never
+// wrap, since it keeps the sum of |amount| over its rows within int64.
+struct IncomeExpenseSums {
+    int64_t income{0};
+    int64_t expense{0}; // positive magnitude
+};
+
+inline bool cpuHasAvx2() {
+#if defined(LEDGER_X86) && (defined(__GNUC__) || defined(__clang__))
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+#elif defined(LEDGER_X86) && defined(_MSC_VER)
+    static const bool has = [] {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }();
+    return has;
+#else
+    return false;
+#endif
+}
+
+inline int64_t wrappingSum(std::initializer_list<int64_t> parts) {
+    uint64_t sum = 0;
+    for (int64_t x: parts) sum += static_cast<uint64_t>(x);
+    return static_cast<int64_t>(sum);
+}
+
+inline IncomeExpenseSums sumIncomeExpenseScalar(const int64_t* a, size_t n) {
+    uint64_t income = 0, expense = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] >= 0) income += static_cast<uint64_t>(a[i]);
+        else expense -= static_cast<uint64_t>(a[i]);
+    }
+    return {static_cast<int64_t>(income), static_cast<int64_t>(expense)};
+}
+
+#ifdef LEDGER_X86
+// SSE2 has no 64-bit compare; the sign of each lane is spread from its high dword instead.
+inline IncomeExpenseSums sumIncomeExpenseSse2(const int64_t* a, size_t n) {
+    __m128i inc0 = _mm_setzero_si128(), inc1 = inc0, exp0 = inc0, exp1 = inc0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 2));
+        __m128i neg0 = _mm_shuffle_epi32(_mm_srai_epi32(x0, 31), _MM_SHUFFLE(3, 3, 1, 1));
+        __m128i neg1 = _mm_shuffle_epi32(_mm_srai_epi32(x1, 31), _MM_SHUFFLE(3, 3, 1, 1));
+        inc0 = _mm_add_epi64(inc0, _mm_andnot_si128(neg0, x0));
+        inc1 = _mm_add_epi64(inc1, _mm_andnot_si128(neg1, x1));
+        exp0 = _mm_sub_epi64(exp0, _mm_and_si128(neg0, x0));
+        exp1 = _mm_sub_epi64(exp1, _mm_and_si128(neg1, x1));
+    }
+    int64_t inc[2], exp[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(inc), _mm_add_epi64(inc0, inc1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(exp), _mm_add_epi64(exp0, exp1));
+    IncomeExpenseSums tail = sumIncomeExpenseScalar(a + i, n - i);
+    return {wrappingSum({inc[0], inc[1], tail.income}), wrappingSum({exp[0], exp[1], tail.expense})};
+}
+
+LEDGER_TARGET_AVX2
+inline IncomeExpenseSums sumIncomeExpenseAvx2(const int64_t* a, size_t n) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i inc0 = zero, inc1 = zero, exp0 = zero, exp1 = zero;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 4));
+        __m256i neg0 = _mm256_cmpgt_epi64(zero, x0), neg1 = _mm256_cmpgt_epi64(zero, x1);
+        inc0 = _mm256_add_epi64(inc0, _mm256_andnot_si256(neg0, x0));
+        inc1 = _mm256_add_epi64(inc1, _mm256_andnot_si256(neg1, x1));
+        exp0 = _mm256_sub_epi64(exp0, _mm256_and_si256(neg0, x0));
+        exp1 = _mm256_sub_epi64(exp1, _mm256_and_si256(neg1, x1));
+    }
+    int64_t inc[4], exp[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(inc), _mm256_add_epi64(inc0, inc1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(exp), _mm256_add_epi64(exp0, exp1));
+    IncomeExpenseSums tail = sumIncomeExpenseScalar(a + i, n - i);
+    return {wrappingSum({inc[0], inc[1], inc[2], inc[3], tail.income}), wrappingSum({exp[0], exp[1], exp[2], exp[3], tail.expense})};
+}
+#endif
+
+// Sum of non-negative amounts and of the magnitudes of negative ones.
+inline IncomeExpenseSums sumIncomeExpense(const int64_t* a, size_t n) {
+#ifdef LEDGER_X86
+    if (cpuHasAvx2()) return sumIncomeExpenseAvx2(a, n);
+    return sumIncomeExpenseSse2(a, n);
+#else
+    return sumIncomeExpenseScalar(a, n);
+#endif
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Small-memory summaries for streaming queries. Both kinds merge: summaries built over parts
+// of the data (threads, shards, segments) combine into one over the whole, so a query can be
+// answered in one pass per part and a final merge.
+
+// The n greatest items seen (by Less), in O(n) memory and O(log n) per push.
+template <class T, class Less = std::less<T>>
+class TopN {
+public:
+    explicit TopN(size_t n, Less less = Less()): limit(n), less(less) {}
+
+    void push(const T& item) {
+        if (limit == 0) return;
+        if (heap.size() < limit) {
+            heap.push_back(item);
+            std::push_heap(heap.begin(), heap.end(), greater());
+        } else if (less(heap.front(), item)) {
+            std::pop_heap(heap.begin(), heap.end(), greater());
+            heap.back() = item;
+            std::push_heap(heap.begin(), heap.end(), greater());
+        }
+    }
+
+    void merge(const TopN& other) {
+        for (const T& item: other.heap) push(item);
+    }
+
+    size_t size() const { return heap.size(); }
+    size_t capacity() const { return limit; }
+
+    // Smallest item kept, i.e. what a new item has to beat once the heap is full.
+    const T& threshold() const { return heap.front(); }
+    bool full() const { return heap.size() == limit; }
+
+    // Greatest first.
+    std::vector<T> sorted() const {
+        std::vector<T> out(heap);
+        std::sort(out.begin(), out.end(), [&](const T& a, const T& b) { return less(b, a); });
+        return out;
+    }
+
+private:
+    size_t limit;
+    Less less;
+    std::vector<T> heap; // min-heap under less, so the front is the one to evict
+
+    auto greater() const { return [this](const T& a, const T& b) { return less(b, a); }; }
+};
+
+// KLL quantile sketch (Karnin, Lang, Liberty 2016) over int64 values.
+//
+// Level h holds items of weight 2^h. When the sketch is over capacity, a full level is sorted
+// and every other item (odd or even positions, at random) moves up a level with double
+// weight. Level capacities shrink geometrically (by 2/3) going down from the top, so about
+// 3k items are retained however many were added, and a quantile's rank is off by roughly
+// 1.7/k of the count (about 1% for the default k = 200). Min and max are exact.
+//
+// Coin flips come from a xorshift generator with a fixed seed, so the same input in the same
+// order always gives the same sketch.
+class QuantileSketch {
+public:
+    explicit QuantileSketch(uint32_t k = 200): k(k) { grow(); }
+
+    void add(int64_t v) {
+        levels[0].push_back(v);
+        ++n;
+        ++retainedItems;
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        if (retainedItems >= maxRetained) compress();
+    }
+
+    void merge(const QuantileSketch& other) {
+        if (other.n == 0) return;
+        while (levels.size() < other.levels.size()) grow();
+        for (size_t h = 0; h < other.levels.size(); ++h) {
+            levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+            retainedItems += other.levels[h].size();
+        }
+        n += other.n;
+        lo = std::min(lo, other.lo);
+        hi = std::max(hi, other.hi);
+        while (retainedItems >= maxRetained) compress();
+    }
+
+    uint64_t count() const { return n; }
+    bool empty() const { return n == 0; }
+    int64_t min() const { return n ? lo : 0; }
+    int64_t max() const { return n ? hi : 0; }
+    size_t retained() const { return retainedItems; }
+
+    // Value at quantile q in [0, 1] (0 = min, 0.5 = median, 1 = max); 0 for an empty sketch.
+    int64_t quantile(double q) const {
+        if (n == 0) return 0;
+        if (q <= 0) return lo;
+        if (q >= 1) return hi;
+        auto items = weighted();
+        uint64_t target = static_cast<uint64_t>(std::ceil(q * static_cast<double>(n)));
+        uint64_t seen = 0;
+        for (auto &it: items) {
+            seen += it.second;
+            if (seen >= target) return it.first;
+        }
+        return hi;
+    }
+
+    // Several quantiles (ascending q) with one sort.
+    std::vector<int64_t> quantiles(const std::vector<double>& qs) const {
+        std::vector<int64_t> out;
+        auto items = weighted();
+        size_t i = 0;
+        uint64_t seen = 0;
+        for (double q: qs) {
+            if (n == 0) { out.push_back(0); continue; }
+            if (q <= 0) { out.push_back(lo); continue; }
+            if (q >= 1) { out.push_back(hi); continue; }
+            uint64_t target = static_cast<uint64_t>(std::ceil(q * static_cast<double>(n)));
+            while (i < items.size() && seen + items[i].second < target) seen += items[i++].second;
+            out.push_back(i < items.size() ? items[i].first : hi);
+        }
+        return out;
+    }
+
+    size_t bytesReserved() const {
+        size_t bytes = levels.capacity() * sizeof(levels[0]);
+        for (auto &l: levels) bytes += l.capacity() * sizeof(int64_t);
+        return bytes;
+    }
+
+private:
+    uint32_t k;
+    uint64_t n{0};
+    int64_t lo{std::numeric_limits<int64_t>::max()}, hi{std::numeric_limits<int64_t>::min()};
+    std::vector<std::vector<int64_t>> levels;
+    size_t retainedItems{0}, maxRetained{0};
+    uint64_t rng{0x9E3779B97F4A7C15ull};
+
+    size_t capacity(size_t h) const {
+        size_t depth = levels.size() - h - 1;
+        return static_cast<size_t>(std::ceil(std::pow(2.0 / 3.0, static_cast<double>(depth)) * k)) + 1;
+    }
+
+    void grow() {
+        levels.emplace_back();
+        maxRetained = 0;
+        for (size_t h = 0; h < levels.size(); ++h) maxRetained += capacity(h);
+    }
+
+    bool coin() {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng & 1;
+    }
+
+    // Compact full levels from the bottom up until the sketch is back under capacity.
+    void compress() {
+        for (size_t h = 0; h < levels.size(); ++h) {
+            if (levels[h].size() < capacity(h)) continue;
+            if (h + 1 == levels.size()) grow();
+            auto &level = levels[h];
+            std::sort(level.begin(), level.end());
+            // an odd item out stays behind
+            size_t pairs = level.size() / 2;
+            size_t start = level.size() % 2;
+            size_t pick = coin() ? 1 : 0;
+            auto &up = levels[h + 1];
+            for (size_t i = 0; i < pairs; ++i) up.push_back(level[start + 2 * i + pick]);
+            level.resize(start);
+            // lower levels only shrink as the sketch grows; give back what they no longer need
+            if (level.capacity() > 2 * capacity(h)) std::vector<int64_t>(level).swap(level);
+            retainedItems -= pairs;
+            if (retainedItems < maxRetained) break;
+        }
+    }
+
+    // (value, weight) for every retained item, by value.
+    std::vector<std::pair<int64_t, uint64_t>> weighted() const {
+        std::vector<std::pair<int64_t, uint64_t>> items;
+        items.reserve(retainedItems);
+        for (size_t h = 0; h < levels.size(); ++h) {
+            for (int64_t v: levels[h]) items.emplace_back(v, uint64_t(1) << h);
+        }
+        std::sort(items.begin(), items.end());
+        return items;
+    }
+};
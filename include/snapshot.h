@@ -0,0 +1,251 @@
+#pragma once
+#include "repositories.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <filesystem>
+
+// Binary columnar snapshot of a TransactionRepository ("*.snap").
+//
+//   SnapshotHeader
+//   amounts        int64[rows]        Decimal::raw() units (version 1: double)
+//   epochs         int64[rows]        seconds since 1970
+//   categories     int32[rows]        index into the category table, -1 = uncategorized
+//   txnIds         uint64[rows + 1]   offsets into the string heap
+//   merchants      uint64[rows + 1]
+//   notes          uint64[rows + 1]
+//   categoryTypes  int32[cats]
+//   categoryNames  uint64[cats + 1]
+//   heap           all string bytes, back to back
+//   userIds        uint64[rows + 1]   (version 3)
+//   accountIds     uint64[rows + 1]   (version 3)
+//
+// Every section starts on an 8-byte boundary, so a mapped file can be read in place: the
+// numeric columns are usable as plain arrays and string columns are only touched when asked for.
+// Integers are stored in host byte order; the header's byteOrder tag rejects foreign files.
+
+constexpr char kSnapshotMagic[8] = {'S','L','S','N','A','P','\0','\0'};
+constexpr uint32_t kSnapshotVersion = 3; // 1 stored amounts as double, 2 had no user/account; both readable
+constexpr uint32_t kSnapshotByteOrder = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t rows;
+    uint64_t categories;
+    uint64_t amounts, epochs, categoryIds;
+    uint64_t txnIds, merchants, notes;
+    uint64_t categoryTypes, categoryNames;
+    uint64_t heap, heapSize;
+    uint64_t userIds, accountIds; // version 3
+};
+
+// Read-only view over a mapped snapshot. Nothing is copied on open, but every section, string
+// offset and category id is checked against the file first, so a truncated or corrupt file is
+// rejected (isValid() false) rather than read out of bounds.
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& path): file(path) {
+        if (file.size() < sizeof(SnapshotHeader)) return;
+        std::memcpy(&hdr, file.data(), sizeof hdr);
+        if (std::memcmp(hdr.magic, kSnapshotMagic, sizeof kSnapshotMagic) != 0) return;
+        if (hdr.version < 1 || hdr.version > kSnapshotVersion || hdr.byteOrder != kSnapshotByteOrder) return;
+        if (hdr.version < 3) hdr.userIds = hdr.accountIds = 0; // older headers end before these
+        valid = checkLayout();
+    }
+
+    bool isValid() const { return valid; }
+    size_t size() const { return valid ? static_cast<size_t>(hdr.rows) : 0; }
+    size_t fileSize() const { return file.size(); }
+    size_t categoryCount() const { return valid ? static_cast<size_t>(hdr.categories) : 0; }
+
+    // Amount column in Decimal units; null for a version 1 file, use amount(i) there.
+    const int64_t* amounts() const { return hdr.version >= 2 ? section<int64_t>(hdr.amounts) : nullptr; }
+    Decimal amount(size_t i) const {
+        if (hdr.version >= 2) return Decimal::fromRaw(section<int64_t>(hdr.amounts)[i]);
+        return Decimal(section<double>(hdr.amounts)[i]);
+    }
+    const int64_t* epochs() const { return section<int64_t>(hdr.epochs); }
+    const int32_t* categoryIds() const { return section<int32_t>(hdr.categoryIds); }
+
+    std::string_view txnId(size_t i) const { return str(hdr.txnIds, i); }
+    std::string_view merchant(size_t i) const { return str(hdr.merchants, i); }
+    std::string_view notes(size_t i) const { return str(hdr.notes, i); }
+    std::string_view userId(size_t i) const { return hdr.userIds ? str(hdr.userIds, i) : std::string_view(); }
+    std::string_view accountId(size_t i) const { return hdr.accountIds ? str(hdr.accountIds, i) : std::string_view(); }
+    std::string_view categoryName(size_t c) const { return str(hdr.categoryNames, c); }
+    CategoryType categoryType(size_t c) const {
+        return section<int32_t>(hdr.categoryTypes)[c] == 1 ? CategoryType::Income : CategoryType::Expense;
+    }
+
+private:
+    MappedFile file;
+    SnapshotHeader hdr{};
+    bool valid{false};
+
+    template <class T>
+    const T* section(uint64_t offset) const { return reinterpret_cast<const T*>(file.data() + offset); }
+
+    // True if count elements of size bytes starting at offset lie inside the file.
+    bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t align = 8) const {
+        uint64_t len = file.size();
+        return offset % align == 0 && offset <= len && count <= (len - offset) / size;
+    }
+
+    // A string column's offsets must never decrease and must end inside the heap.
+    bool checkStrings(uint64_t offsets, uint64_t count) const {
+        if (!fits(offsets, count + 1, sizeof(uint64_t))) return false;
+        const uint64_t* o = section<uint64_t>(offsets);
+        for (uint64_t i = 0; i < count; ++i) if (o[i] > o[i+1]) return false;
+        return o[count] <= hdr.heapSize;
+    }
+
+    bool checkLayout() const {
+        const uint64_t rows = hdr.rows, cats = hdr.categories;
+        if (rows > file.size() || cats > file.size()) return false; // also keeps rows + 1 from wrapping
+        if (!fits(hdr.amounts, rows, 8) || !fits(hdr.epochs, rows, 8) || !fits(hdr.categoryIds, rows, 4)) return false;
+        if (!fits(hdr.categoryTypes, cats, 4) || !fits(hdr.heap, hdr.heapSize, 1, 1)) return false;
+        if (cats > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) return false;
+        if (!checkStrings(hdr.txnIds, rows) || !checkStrings(hdr.merchants, rows) || !checkStrings(hdr.notes, rows)) return false;
+        if (!checkStrings(hdr.categoryNames, cats)) return false;
+        if (hdr.version >= 3 && (!checkStrings(hdr.userIds, rows) || !checkStrings(hdr.accountIds, rows))) return false;
+        const int32_t* catIds = section<int32_t>(hdr.categoryIds);
+        for (uint64_t i = 0; i < rows; ++i) {
+            if (catIds[i] < -1 || catIds[i] >= static_cast<int64_t>(cats)) return false;
+        }
+        if (hdr.version < 2) {
+            // Decimal(double) throws on amounts beyond its range; refuse them here instead
+            const double* amounts = section<double>(hdr.amounts);
+            for (uint64_t i = 0; i < rows; ++i) {
+                double scaled = std::round(amounts[i] * Decimal::kUnit);
+                if (!(scaled > -9223372036854775808.0 && scaled < 9223372036854775808.0)) return false;
+            }
+        }
+        return true;
+    }
+
+    std::string_view str(uint64_t offsets, size_t i) const {
+        const uint64_t* o = section<uint64_t>(offsets);
+        return std::string_view(file.data() + hdr.heap + o[i], static_cast<size_t>(o[i+1] - o[i]));
+    }
+};
+
+// Write rows (a std::vector<Transaction> or a TxnView) as a snapshot, via a temporary file
+// that replaces `path` when complete.
+template <class Rows>
+static bool writeSnapshot(const std::string& path, const Rows& rows) {
+    const size_t n = rows.size();
+
+    std::vector<int64_t> amounts(n);
+    std::vector<int64_t> epochs(n);
+    std::vector<int32_t> catIds(n, -1);
+    std::vector<uint64_t> idOffs(n + 1), merchantOffs(n + 1), notesOffs(n + 1), userOffs(n + 1), accountOffs(n + 1);
+    std::vector<int32_t> catTypes;
+    std::vector<uint64_t> catNameOffs{0};
+    std::map<std::string, int32_t> catIndex;
+    std::string heap;
+
+    auto pushString = [&](std::string_view s) { heap += s; return static_cast<uint64_t>(heap.size()); };
+    for (size_t i = 0; i < n; ++i) {
+        amounts[i] = rows[i].amount.raw();
+        epochs[i] = static_cast<int64_t>(std::chrono::system_clock::to_time_t(rows[i].date));
+        if (rows[i].category) {
+            auto it = catIndex.find(rows[i].category->name);
+            if (it == catIndex.end()) {
+                it = catIndex.emplace(rows[i].category->name, static_cast<int32_t>(catIndex.size())).first;
+                catTypes.push_back(static_cast<int32_t>(rows[i].category->type));
+            }
+            catIds[i] = it->second;
+        }
+    }
+    idOffs[0] = heap.size();
+    for (size_t i = 0; i < n; ++i) idOffs[i+1] = pushString(rows[i].txnId);
+    merchantOffs[0] = heap.size();
+    for (size_t i = 0; i < n; ++i) merchantOffs[i+1] = pushString(rows[i].merchant);
+    notesOffs[0] = heap.size();
+    for (size_t i = 0; i < n; ++i) notesOffs[i+1] = pushString(rows[i].notes);
+    userOffs[0] = heap.size();
+    for (size_t i = 0; i < n; ++i) userOffs[i+1] = pushString(rows[i].userId);
+    accountOffs[0] = heap.size();
+    for (size_t i = 0; i < n; ++i) accountOffs[i+1] = pushString(rows[i].accountId);
+
+    std::vector<const std::string*> catNames(catIndex.size());
+    for (auto &kv: catIndex) catNames[static_cast<size_t>(kv.second)] = &kv.first;
+    catNameOffs[0] = heap.size();
+    for (size_t c = 0; c < catNames.size(); ++c) catNameOffs.push_back(pushString(*catNames[c]));
+
+    SnapshotHeader hdr{};
+    std::memcpy(hdr.magic, kSnapshotMagic, sizeof kSnapshotMagic);
+    hdr.version = kSnapshotVersion;
+    hdr.byteOrder = kSnapshotByteOrder;
+    hdr.rows = n;
+    hdr.categories = catNames.size();
+    uint64_t pos = sizeof(SnapshotHeader);
+    auto place = [&](uint64_t bytes) { pos = (pos + 7) & ~uint64_t(7); uint64_t at = pos; pos += bytes; return at; };
+    hdr.amounts = place(n * sizeof(int64_t));
+    hdr.epochs = place(n * sizeof(int64_t));
+    hdr.categoryIds = place(n * sizeof(int32_t));
+    hdr.txnIds = place((n + 1) * sizeof(uint64_t));
+    hdr.merchants = place((n + 1) * sizeof(uint64_t));
+    hdr.notes = place((n + 1) * sizeof(uint64_t));
+    hdr.categoryTypes = place(catTypes.size() * sizeof(int32_t));
+    hdr.categoryNames = place(catNameOffs.size() * sizeof(uint64_t));
+    hdr.heap = place(heap.size());
+    hdr.heapSize = heap.size();
+    hdr.userIds = place((n + 1) * sizeof(uint64_t));
+    hdr.accountIds = place((n + 1) * sizeof(uint64_t));
+
+    std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = true;
+    uint64_t written = 0;
+    auto put = [&](uint64_t at, const void* data, size_t bytes) {
+        static const char zeros[8] = {};
+        if (at > written) ok &= std::fwrite(zeros, 1, static_cast<size_t>(at - written), f) == at - written;
+        if (bytes) ok &= std::fwrite(data, 1, bytes, f) == bytes;
+        written = at + bytes;
+    };
+    put(0, &hdr, sizeof hdr);
+    put(hdr.amounts, amounts.data(), n * sizeof(int64_t));
+    put(hdr.epochs, epochs.data(), n * sizeof(int64_t));
+    put(hdr.categoryIds, catIds.data(), n * sizeof(int32_t));
+    put(hdr.txnIds, idOffs.data(), (n + 1) * sizeof(uint64_t));
+    put(hdr.merchants, merchantOffs.data(), (n + 1) * sizeof(uint64_t));
+    put(hdr.notes, notesOffs.data(), (n + 1) * sizeof(uint64_t));
+    put(hdr.categoryTypes, catTypes.data(), catTypes.size() * sizeof(int32_t));
+    put(hdr.categoryNames, catNameOffs.data(), catNameOffs.size() * sizeof(uint64_t));
+    put(hdr.heap, heap.data(), heap.size());
+    put(hdr.userIds, userOffs.data(), (n + 1) * sizeof(uint64_t));
+    put(hdr.accountIds, accountOffs.data(), (n + 1) * sizeof(uint64_t));
+    ok &= syncFile(f);
+    ok &= std::fclose(f) == 0;
+    if (!ok) return false;
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    return !ec;
+}
+
+// Append every row of a snapshot to the repository, straight from the mapped columns
+// (TransactionRepository::loadColumns): no Transaction or std::string is built per row and
+// strings are copied once, from the heap into the repository. The mapping is released on
+// return. Category names are resolved through catRepo the same way loadFromCsv does.
+static bool loadSnapshot(const std::string& path, TransactionRepository& repo, CategoryRepository* catRepo=nullptr) {
+    SnapshotReader snap(path);
+    if (!snap.isValid()) return false;
+    std::vector<std::shared_ptr<Category>> cats(snap.categoryCount());
+    if (catRepo) {
+        for (size_t c = 0; c < cats.size(); ++c) cats[c] = catRepo->findByName(std::string(snap.categoryName(c)));
+    }
+    repo.loadColumns(snap, cats);
+    LEDGER_COUNT(BytesRead, snap.fileSize());
+    LEDGER_COUNT(RowsLoaded, snap.size());
+    return true;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include "dates.h"
+
+// Per-day totals of several series (e.g. income, expense, one per category) in Fenwick trees,
+// so a point update and a prefix sum over days are both O(log days).
+//
+// Day d covers [dayStart(d), dayStart(d) + 86400): 24-hour buckets counted from local
+// midnight, 1 January 2000. They line up with local midnights except while daylight saving
+// time is in effect, where they are an hour off; callers that need exact sums at arbitrary
+// instants combine a prefix over whole days with the rows of the one partial day (see
+// TransactionRepository::incomeExpenseBetween).
+//
+// Values are added unchecked: callers keep the sum of |value| over each series within int64
+// (TransactionRepository bounds it by the sum of |amount| over all of its rows), which keeps
+// every node, prefix and difference of prefixes in range too.
+//
+// Trees only cover the days seen so far; a value outside that span regrows every tree to at
+// least twice the span, O(days * series).
+class DayTotals {
+public:
+    explicit DayTotals(size_t series = 0): trees(series) {}
+
+    static int64_t dayOf(int64_t epoch) {
+        int64_t d = epoch - anchor();
+        return d >= 0 ? d / kDay : -((-d + kDay - 1) / kDay);
+    }
+    static int64_t dayStart(int64_t day) { return anchor() + day * kDay; }
+
+    size_t seriesCount() const { return trees.size(); }
+    void setSeriesCount(size_t n) { trees.resize(n, std::vector<int64_t>(span + 1, 0)); }
+
+    void add(size_t series, int64_t day, int64_t value) {
+        if (value == 0) return;
+        if (span == 0 || day < first || day >= first + static_cast<int64_t>(span)) grow(day);
+        auto &tree = trees[series];
+        for (size_t i = static_cast<size_t>(day - first) + 1; i <= span; i += i & (~i + 1)) tree[i] += value;
+    }
+
+    // Sum of the series over every day before `day`.
+    int64_t prefix(size_t series, int64_t day) const {
+        if (series >= trees.size() || span == 0 || day <= first) return 0;
+        size_t n = std::min(static_cast<size_t>(day - first), span);
+        int64_t sum = 0;
+        for (size_t i = n; i > 0; i &= i - 1) sum += trees[series][i];
+        return sum;
+    }
+
+    int64_t dayValue(size_t series, int64_t day) const { return prefix(series, day + 1) - prefix(series, day); }
+
+    // Fold series `from` into `to` (trees are linear, so element-wise) and zero it.
+    void moveSeries(size_t from, size_t to) {
+        if (from == to || from >= trees.size() || to >= trees.size()) return;
+        for (size_t i = 0; i <= span; ++i) trees[to][i] += trees[from][i];
+        std::fill(trees[from].begin(), trees[from].end(), 0);
+    }
+
+    // Days [firstDay(), firstDay() + days()) are covered.
+    int64_t firstDay() const { return first; }
+    size_t days() const { return span; }
+
+    size_t bytesReserved() const {
+        size_t n = trees.capacity() * sizeof(trees[0]);
+        for (auto &t: trees) n += t.capacity() * sizeof(int64_t);
+        return n;
+    }
+
+private:
+    static constexpr int64_t kDay = 86400;
+    int64_t first{0};
+    size_t span{0};
+    std::vector<std::vector<int64_t>> trees; // per series, 1-based, span + 1 entries
+
+    static int64_t anchor() {
+        static const int64_t start = MonthTable::instance().start(monthKey(2000, 1));
+        return start;
+    }
+
+    // Cover `day` as well: unbuild each tree to plain daily values, shift them into the new
+    // span and rebuild, both in O(span).
+    void grow(int64_t day) {
+        int64_t newFirst;
+        size_t want;
+        if (span == 0) {
+            want = 64;
+            newFirst = day - 8;
+        } else {
+            int64_t lo = std::min(first, day), hi = std::max(first + static_cast<int64_t>(span), day + 1);
+            want = std::max(static_cast<size_t>(hi - lo), 2 * span);
+            // the slack goes on the side that grew
+            newFirst = day < first ? hi - static_cast<int64_t>(want) : lo;
+        }
+        for (auto &tree: trees) {
+            for (size_t i = span; i > 0; --i) {
+                size_t parent = i + (i & (~i + 1));
+                if (parent <= span) tree[parent] -= tree[i];
+            }
+            std::vector<int64_t> next(want + 1, 0);
+            for (size_t i = 1; i <= span; ++i) next[static_cast<size_t>(first - newFirst) + i] = tree[i];
+            for (size_t i = 1; i <= want; ++i) {
+                size_t parent = i + (i & (~i + 1));
+                if (parent <= want) next[parent] += next[i];
+            }
+            tree.swap(next);
+        }
+        first = newFirst;
+        span = want;
+    }
+};
@@ -0,0 +1,17 @@
+#include <cstdlib>
+#include <new>
+#include "metrics.h"
+
+// Heap allocation counts for the stats surface. These replacements live in a translation unit
+// of their own: inlined into main.cpp, GCC pairs each delete with the malloc behind new and
+// warns -Wmismatched-new-delete at every call site. The array and sized forms forward to these.
+#ifdef LEDGER_METRICS
+void* operator new(std::size_t n) {
+    LEDGER_COUNT(Allocations, 1);
+    LEDGER_COUNT(AllocatedBytes, n);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#endif
@@ -0,0 +1,433 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "models.h"
+#include "repositories.h"
+#include "services.h"
+#include "query.h"
+#include "sharded_repository.h"
+
+// Microbenchmarks over a synthetic ledger, reported as JSON.
+//   ledger_bench [--rows 10K,1M,10M] [--seed N] [--min-ms N] [--filter substring] [--out results.json]
+// Progress goes to stderr; the JSON document goes to --out, or stdout without it.
+
+namespace {
+
+// Deterministic on every platform: only the raw mt19937_64 stream is used (its output is
+// fixed by the standard), never the implementation-defined std:: distributions.
+class Rng {
+public:
+    explicit Rng(uint64_t seed): engine(seed) {}
+    size_t below(size_t n) { return static_cast<size_t>(engine() % n); }
+    int64_t between(int64_t lo, int64_t hi) { return lo + static_cast<int64_t>(engine() % static_cast<uint64_t>(hi - lo + 1)); }
+private:
+    std::mt19937_64 engine;
+};
+
+struct MerchantProfile {
+    const char* name;
+    const char* category;   // nullptr: usually left uncategorized
+    int weight;             // relative frequency
+    int64_t minCents, maxCents; // negative = expense
+    const char* notes;
+};
+
+// A mix of chains (many rows), small shops and income, with CJK, Cyrillic and accented names.
+const MerchantProfile kMerchants[] = {
+    {"星巴克咖啡", "Food", 60, -4500, -800, "咖啡"},
+    {"麦当劳", "Food", 50, -6000, -1500, "午餐"},
+    {"肯德基", "Food", 35, -7000, -1800, "lunch"},
+    {"全家便利店", "Groceries", 45, -5000, -300, "便利店购物"},
+    {"盒马鲜生", "Groceries", 30, -40000, -2000, "周末买菜"},
+    {"滴滴出行", "Transport", 40, -9000, -1200, "打车回家"},
+    {"地铁 Metro", "Transport", 70, -600, -300, "subway"},
+    {"中国石化", "Transport", 10, -50000, -20000, "加油"},
+    {"美团外卖", "Food", 55, -9000, -2000, "外卖 meal"},
+    {"淘宝网", "Shopping", 30, -80000, -1000, "网购"},
+    {"京东商城", "Shopping", 25, -150000, -2000, "电子产品"},
+    {"Пятёрочка", "Groceries", 20, -30000, -1500, "продукты"},
+    {"Яндекс Такси", "Transport", 12, -12000, -2500, "такси"},
+    {"Café Lumière", "Food", 15, -2500, -600, "petit déjeuner"},
+    {"Boulangerie Élise", "Food", 10, -1500, -300, ""},
+    {"Müller Drogerie", "Health", 8, -4000, -500, ""},
+    {"Walmart Supercenter", "Groceries", 25, -25000, -1500, "weekly groceries"},
+    {"Amazon Marketplace", "Shopping", 30, -20000, -900, "online order"},
+    {"Shell Station", "Transport", 12, -9000, -3000, "fuel"},
+    {"City Bus", "Transport", 25, -300, -200, "bus fare"},
+    {"Netflix", "Entertainment", 4, -1599, -1599, "subscription"},
+    {"Cinema City", "Entertainment", 6, -3000, -1200, "movie night"},
+    {"State Grid 国家电网", "Utilities", 4, -30000, -8000, "电费"},
+    {"Comcast", "Utilities", 3, -9000, -6000, "internet"},
+    {"Landlord", "Rent", 3, -350000, -180000, "monthly rent"},
+    {"Pharmacy Plus", "Health", 6, -6000, -500, ""},
+    {"Airline 航空", "Travel", 2, -250000, -40000, "flight"},
+    {"Hotel Москва", "Travel", 2, -120000, -20000, "hotel"},
+    {"ACME Corp", "Salary", 3, 500000, 900000, "monthly salary"},
+    {"Freelance client", nullptr, 2, 20000, 300000, "invoice paid"},
+    {"Refund", nullptr, 3, 500, 20000, "return"},
+    {"Corner shop", nullptr, 20, -3000, -200, ""},
+    {"小卖部", nullptr, 15, -2000, -100, "零食"},
+    {"Market stall", nullptr, 10, -2500, -300, "misc"},
+};
+
+const char* const kCategories[] = {"Food", "Transport", "Salary", "Groceries", "Rent", "Shopping",
+                                   "Entertainment", "Utilities", "Travel", "Health"};
+
+const size_t kUsers = 100;
+const char* const kAccounts[] = {"checking", "card"};
+
+// `rows` transactions over three years starting 2023-01-01 UTC, mostly in date order with some
+// late arrivals, spread over kUsers users with two accounts each. About 15% of rows are
+// uncategorized even when their merchant has a category.
+std::vector<Transaction> generateLedger(size_t rows, uint64_t seed, CategoryRepository& cats) {
+    for (auto name: kCategories) {
+        if (!cats.findByName(name)) cats.save(Category{std::string("c_") + name, name, std::string(name) == "Salary" ? CategoryType::Income : CategoryType::Expense});
+    }
+    std::vector<int> cumulative;
+    int total = 0;
+    for (auto &m: kMerchants) cumulative.push_back(total += m.weight);
+    std::vector<std::shared_ptr<Category>> catOf;
+    for (auto &m: kMerchants) catOf.push_back(m.category ? cats.findByName(m.category) : nullptr);
+
+    Rng rng(seed);
+    const int64_t start = 1672531200; // 2023-01-01T00:00:00Z
+    const int64_t span = 3 * 365 * 86400LL;
+    std::vector<Transaction> out(rows);
+    for (size_t i = 0; i < rows; ++i) {
+        int pick = static_cast<int>(rng.below(static_cast<size_t>(total)));
+        size_t m = static_cast<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), pick) - cumulative.begin());
+        const MerchantProfile& p = kMerchants[m];
+        Transaction& t = out[i];
+        t.txnId = "g" + std::to_string(i);
+        t.amount = Decimal::fromRaw(rng.between(p.minCents, p.maxCents) * 100);
+        int64_t epoch = start + static_cast<int64_t>(span * static_cast<double>(i) / static_cast<double>(rows ? rows : 1));
+        if (rng.below(20) == 0) epoch -= rng.between(0, 30 * 86400); // late arrival
+        t.date = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(epoch));
+        t.merchant = p.name;
+        if (rng.below(4) == 0) t.merchant += " #" + std::to_string(rng.below(500)); // branch number
+        t.notes = p.notes;
+        if (catOf[m] && rng.below(100) >= 15) t.category = catOf[m];
+        t.userId = "u" + std::to_string(rng.below(kUsers));
+        t.accountId = kAccounts[rng.below(2)];
+    }
+    return out;
+}
+
+struct Result {
+    std::string name;
+    size_t rows;
+    size_t iterations;
+    size_t opsPerIteration;
+    double totalMs;
+    double minMs;
+};
+
+struct MemoryResult {
+    std::string name;
+    size_t rows;
+    size_t bytes;
+};
+
+class Bench {
+public:
+    Bench(double minMs, std::string filter): minMs(minMs), filter(std::move(filter)) {}
+
+    // Time fn (ops operations per call) until minMs has passed, after one untimed warm-up
+    // call; heavy fns run once, cold. Setup
+    // steps that later benchmarks depend on still run, untimed, when filtered out.
+    void run(const std::string& name, size_t rows, size_t ops, const std::function<uint64_t()>& fn, bool once = false, bool setup = false) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            if (setup) fn();
+            return;
+        }
+        Result r{name, rows, 0, ops, 0, 0};
+        if (!once) sink ^= fn();
+        do {
+            auto t0 = std::chrono::steady_clock::now();
+            sink ^= fn();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            r.minMs = r.iterations == 0 ? ms : std::min(r.minMs, ms);
+            r.totalMs += ms;
+            ++r.iterations;
+        } while (!once && r.totalMs < minMs);
+        std::cerr << "  " << name << ": " << r.totalMs / static_cast<double>(r.iterations) << " ms/iter (" << r.iterations << " iters)\n";
+        results.push_back(r);
+    }
+
+    // Record a memory figure (heap bytes held by some structure) alongside the timings.
+    void memory(const std::string& name, size_t rows, size_t bytes) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        std::cerr << "  " << name << ": " << static_cast<double>(bytes) / static_cast<double>(rows ? rows : 1) << " bytes/row\n";
+        memoryResults.push_back(MemoryResult{name, rows, bytes});
+    }
+
+    void writeJson(std::ostream& os, uint64_t seed) const {
+        os << "{\n  \"benchmark\": \"ledger_bench\",\n  \"format\": 1,\n  \"seed\": " << seed
+           << ",\n  \"timestamp\": " << static_cast<long long>(std::time(nullptr)) << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            double perOp = r.totalMs * 1e6 / static_cast<double>(r.iterations * (r.opsPerIteration ? r.opsPerIteration : 1));
+            os << "    {\"name\": \"" << r.name << "\", \"rows\": " << r.rows << ", \"iterations\": " << r.iterations
+               << ", \"ops_per_iteration\": " << r.opsPerIteration << ", \"total_ms\": " << r.totalMs
+               << ", \"min_ms\": " << r.minMs << ", \"ns_per_op\": " << perOp << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        os << "  ],\n  \"memory\": [\n";
+        for (size_t i = 0; i < memoryResults.size(); ++i) {
+            const MemoryResult& m = memoryResults[i];
+            os << "    {\"name\": \"" << m.name << "\", \"rows\": " << m.rows << ", \"bytes\": " << m.bytes
+               << ", \"bytes_per_row\": " << static_cast<double>(m.bytes) / static_cast<double>(m.rows ? m.rows : 1) << "}"
+               << (i + 1 < memoryResults.size() ? "," : "") << "\n";
+        }
+        os << "  ],\n  \"checksum\": " << sink << "\n}\n";
+    }
+
+private:
+    double minMs;
+    std::string filter;
+    std::vector<Result> results;
+    std::vector<MemoryResult> memoryResults;
+    uint64_t sink{0}; // keeps results observable so nothing is optimized away
+};
+
+size_t parseCount(const std::string& s) {
+    size_t n = static_cast<size_t>(std::stoull(s));
+    char unit = s.empty() ? '\0' : s.back();
+    if (unit == 'k' || unit == 'K') n *= 1000;
+    if (unit == 'm' || unit == 'M') n *= 1000000;
+    return n;
+}
+
+void benchLedger(Bench& bench, size_t rows, uint64_t seed) {
+    std::cerr << rows << " rows\n";
+    CategoryRepository cats;
+    std::vector<Transaction> ledger;
+    bench.run("generate", rows, rows, [&] { ledger = generateLedger(rows, seed, cats); return ledger.size(); }, true, true);
+
+    TransactionRepository repo;
+    repo.loadRows(std::vector<Transaction>(ledger));
+    auto mem = repo.memoryUsage();
+    bench.memory("TransactionRepository.memory.rows", rows, mem.rows);
+    bench.memory("TransactionRepository.memory.strings", rows, mem.strings);
+    bench.memory("TransactionRepository.memory.indexes", rows, mem.indexes);
+    const std::string csv = "ledger_bench_" + std::to_string(rows) + ".csv";
+    bench.run("saveToCsv", rows, rows, [&] { repo.saveToCsv(csv); return repo.size(); }, true, true);
+    bench.run("loadFromCsv", rows, rows, [&] { TransactionRepository r; r.loadFromCsv(csv, &cats); return r.size(); }, true);
+
+    // 36 months of data: one query per month
+    bench.run("findByUserAndMonth", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int m = 0; m < 36; ++m) n += repo.findByUserAndMonth("u1", 2023 + m / 12, m % 12 + 1).size();
+        return n;
+    });
+
+    // the same queries against per-user shards
+    ShardedTransactionRepository sharded;
+    bench.run("ShardedTransactionRepository.saveBatch", rows, rows, [&] {
+        sharded.saveBatch(std::vector<Transaction>(ledger));
+        return static_cast<uint64_t>(sharded.shardCount());
+    }, true, true);
+    bench.run("ShardedTransactionRepository.findByUserAndMonth", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int m = 0; m < 36; ++m) n += sharded.findByUserAndMonth("u1", 2023 + m / 12, m % 12 + 1).size();
+        return n;
+    });
+
+    ReportService reports(repo);
+    BalanceService balance(repo);
+    auto decimalBits = [](Decimal d) { return static_cast<uint64_t>(d.raw()); };
+    bench.run("BalanceService.calculateBalance", rows, 1, [&] { return decimalBits(balance.calculateBalance()); });
+    bench.run("ReportService.categoryBreakdown", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int m = 0; m < 36; ++m) n += reports.categoryBreakdown(2023 + m / 12, m % 12 + 1).size();
+        return n;
+    });
+    bench.run("ReportService.incomeExpenseTotalsMonth", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int m = 0; m < 36; ++m) n += decimalBits(reports.incomeExpenseTotalsMonth(2023 + m / 12, m % 12 + 1).first);
+        return n;
+    });
+    bench.run("ReportService.incomeExpenseTotalsYear", rows, 3, [&] {
+        uint64_t n = 0;
+        for (int y = 2023; y < 2026; ++y) n += decimalBits(reports.incomeExpenseTotalsYear(y).second);
+        return n;
+    });
+    bench.run("ReportService.categoryBreakdownYear", rows, 3, [&] {
+        uint64_t n = 0;
+        for (int y = 2023; y < 2026; ++y) n += reports.categoryBreakdownYear(y).size();
+        return n;
+    });
+    bench.run("ReportService.categoryBreakdownAll", rows, 1, [&] { return static_cast<uint64_t>(reports.categoryBreakdownAll().size()); });
+    auto year = yearBounds(2024);
+    bench.run("ReportService.incomeExpenseTotalsRange", rows, 1, [&] { return decimalBits(reports.incomeExpenseTotalsRange(year.first, year.second).first); });
+    bench.run("ReportService.categoryBreakdownRange", rows, 1, [&] { return static_cast<uint64_t>(reports.categoryBreakdownRange(year.first, year.second).size()); });
+    // rolling 30-day windows ending mid-day, so both ends cut through a day
+    bench.run("ReportService.incomeExpenseTotalsRolling30d", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int w = 0; w < 36; ++w) {
+            int64_t to = year.first + w * 10 * 86400 + 13 * 3600 + 17;
+            n += decimalBits(reports.incomeExpenseTotalsRange(to - 30 * 86400, to).second);
+        }
+        return n;
+    });
+    bench.run("ReportService.categoryBreakdownRolling30d", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int w = 0; w < 36; ++w) {
+            int64_t to = year.first + w * 10 * 86400 + 13 * 3600 + 17;
+            n += reports.categoryBreakdownRange(to - 30 * 86400, to).size();
+        }
+        return n;
+    });
+    bench.run("ReportService.incomeExpenseSeriesDaily", rows, 366, [&] { return static_cast<uint64_t>(reports.incomeExpenseSeries(year.first, 366).size()); });
+    bench.run("ReportService.incomeExpenseSeriesWeekly", rows, 52, [&] { return static_cast<uint64_t>(reports.incomeExpenseSeries(year.first, 52, 7).size()); });
+
+    QueryService query(repo);
+    bench.run("QueryService.largestExpenses", rows, 1, [&] { return static_cast<uint64_t>(query.largestExpenses(year.first, year.second, 20).sorted().size()); });
+    bench.run("QueryService.largestExpensesInCategory", rows, 1, [&] { return static_cast<uint64_t>(query.largestExpenses(year.first, year.second, 20, "Food").sorted().size()); });
+    bench.run("QueryService.topMerchants", rows, 1, [&] { return static_cast<uint64_t>(query.topMerchants(year.first, year.second, 10).size()); });
+    bench.run("QueryService.amountQuantiles", rows, 1, [&] {
+        auto q = query.amountQuantiles("Food", {0.5, 0.95});
+        return decimalBits(q[0]) + decimalBits(q[1]);
+    });
+    bench.run("QueryService.amountQuantilesRange", rows, 1, [&] { return static_cast<uint64_t>(query.amountSketch("Food", year.first, year.second).quantile(0.95)); });
+
+    const char* queries[] = {"星巴克", "便利店", "Supercenter", "Москва", "Lumière", "#42", "咖啡"};
+    bench.run("searchByKeyword.firstQuery", rows, 1, [&] { return static_cast<uint64_t>(repo.searchByKeyword("外卖").size()); }, true);
+    bench.run("searchByKeyword", rows, sizeof queries / sizeof queries[0], [&] {
+        uint64_t n = 0;
+        for (auto q: queries) n += repo.searchByKeyword(q).size();
+        return n;
+    });
+    bench.memory("TransactionRepository.memory.withTextIndex", rows, repo.memoryUsage().total());
+
+    // the same history with the first two years sealed into compressed blocks
+    TransactionRepository sealed;
+    sealed.loadRows(std::vector<Transaction>(ledger));
+    auto recent = yearBounds(2025);
+    bench.run("TransactionRepository.sealBefore", rows, rows, [&] { return static_cast<uint64_t>(sealed.sealBefore(recent.first)); }, true, true);
+    bench.memory("TransactionRepository.memory.sealed", rows, sealed.memoryUsage().total());
+    bench.run("sealed.findByUserAndMonth", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int m = 0; m < 36; ++m) n += sealed.findByUserAndMonth("u1", 2023 + m / 12, m % 12 + 1).size();
+        return n;
+    });
+    bench.run("sealed.incomeExpenseTotalsRolling30d", rows, 36, [&] {
+        uint64_t n = 0;
+        for (int w = 0; w < 36; ++w) {
+            int64_t to = year.first + w * 10 * 86400 + 13 * 3600 + 17;
+            n += decimalBits(sealed.incomeExpenseBetween(to - 30 * 86400, to).expense);
+        }
+        return n;
+    });
+    bench.run("sealed.searchByKeyword", rows, sizeof queries / sizeof queries[0], [&] {
+        uint64_t n = 0;
+        for (auto q: queries) n += sealed.searchByKeyword(q).size();
+        return n;
+    });
+    QueryService sealedQuery(sealed);
+    bench.run("sealed.QueryService.topMerchants", rows, 1, [&] { return static_cast<uint64_t>(sealedQuery.topMerchants(year.first, year.second, 10).size()); });
+
+    CategorizerService categorizer(cats);
+    categorizer.addRule("星巴克", "Food");
+    categorizer.addRule("便利店", "Groceries");
+    categorizer.addRule("地铁", "Transport");
+    categorizer.addRule("Supercenter", "Groceries");
+    categorizer.addRule("такси", "Transport", 1);
+    bench.run("CategorizerService.train", rows, rows, [&] { categorizer.train(repo); return categorizer.categoryModel().documents(); }, true);
+    bench.memory("CategorizerService.memory.model", rows, categorizer.categoryModel().bytesReserved());
+    size_t sample = std::min<size_t>(rows, 100000);
+    bench.run("CategorizerService.autoCategorize", rows, sample, [&] {
+        uint64_t n = 0;
+        for (size_t i = 0; i < sample; ++i) n += categorizer.autoCategorize(ledger[i]).first != nullptr;
+        return n;
+    });
+    // in import-sized batches
+    bench.run("CategorizerService.autoCategorizeBatch", rows, rows, [&] {
+        uint64_t n = 0;
+        std::vector<const Transaction*> pending;
+        for (size_t i = 0; i < rows; i += ImportOptions().batchRows) {
+            pending.clear();
+            for (size_t k = i; k < std::min(rows, i + ImportOptions().batchRows); ++k) pending.push_back(&ledger[k]);
+            for (auto &r: categorizer.autoCategorizeBatch(pending)) n += r.first != nullptr;
+        }
+        return n;
+    });
+
+    bench.run("TransactionService.importTransactions", rows, rows, [&] {
+        TransactionRepository target;
+        BalanceService b(target);
+        TransactionService svc(target, cats, categorizer, b);
+        return static_cast<uint64_t>(svc.importTransactions(ledger).imported);
+    }, true);
+    bench.run("TransactionService.importFromCsv", rows, rows, [&] {
+        TransactionRepository target;
+        BalanceService b(target);
+        TransactionService svc(target, cats, categorizer, b);
+        return static_cast<uint64_t>(svc.importFromCsv(csv).imported);
+    }, true);
+
+    // re-importing a statement the repository already holds: every row is a duplicate
+    TransactionRepository holder;
+    holder.loadRows(std::vector<Transaction>(ledger));
+    bench.run("TransactionRepository.dedupIndex", rows, rows, [&] { return static_cast<uint64_t>(holder.findDuplicate(ledger[0]) + 1); }, true);
+    bench.memory("TransactionRepository.memory.dedupIndex", rows, holder.memoryUsage().indexes - mem.indexes);
+    bench.run("TransactionRepository.findDuplicate", rows, sample, [&] {
+        uint64_t n = 0;
+        for (size_t i = 0; i < sample; ++i) n += holder.findDuplicate(ledger[i * (rows / sample)], 60) >= 0;
+        return n;
+    });
+    bench.run("TransactionService.importFromCsv.duplicates", rows, rows, [&] {
+        BalanceService b(holder);
+        TransactionService svc(holder, cats, categorizer, b);
+        return static_cast<uint64_t>(svc.importFromCsv(csv).duplicates);
+    }, true);
+    std::remove(csv.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes{10000, 1000000};
+    uint64_t seed = 42;
+    double minMs = 200;
+    std::string filter, outPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rows" && hasValue) {
+            sizes.clear();
+            std::stringstream list(argv[++i]);
+            for (std::string item; std::getline(list, item, ',');) sizes.push_back(parseCount(item));
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--min-ms" && hasValue) {
+            minMs = std::stod(argv[++i]);
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--rows 10K,1M,10M] [--seed N] [--min-ms N] [--filter substring] [--out results.json]\n";
+            return 2;
+        }
+    }
+
+    Bench bench(minMs, filter);
+    for (size_t rows: sizes) benchLedger(bench, rows, seed);
+    if (outPath.empty()) {
+        bench.writeJson(std::cout, seed);
+    } else {
+        std::ofstream out(outPath);
+        bench.writeJson(out, seed);
+        if (!out) { std::cerr << "cannot write " << outPath << '\n'; return 1; }
+    }
+    return 0;
+}
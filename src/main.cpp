@@ -2,9 +2,15 @@
 #include <chrono>
 #include <thread>
 #include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
 #include "models.h"
 #include "repositories.h"
 #include "services.h"
+#include "journal.h"
+#include "cli.h"
+#include "metrics.h"
 
 using namespace std::chrono;
 
@@ -12,26 +18,46 @@ std::string makeId(const std::string& prefix, int n) {
     return prefix + std::to_string(n);
 }
 
-int main(){
+int main(int argc, char** argv){
+    // subcommands (balance, report, breakdown) run headless and exit; see cli.h
+    if (argc > 1) return runCli(argc, argv, std::cout, std::cerr);
+
     TransactionRepository txnRepo;
     CategoryRepository catRepo;
 
     const std::string categoriesFile = "categories.csv";
-    const std::string dataFile = "transactions.csv";
-    // load saved categories first so we don't overwrite them with defaults
-    catRepo.loadFromCsv(categoriesFile);
+    // a binary snapshot (see ledger_snapshot) takes precedence over the CSV file when present
+    const std::string dataFile = std::filesystem::exists("transactions.snap") ? "transactions.snap" : "transactions.csv";
+    const std::string journalFile = "ledger.journal";
+    // load saved categories and transactions, then replay changes made since the last snapshot;
+    // categories come first so we don't overwrite them with defaults
+    Journal journal(dataFile, categoriesFile, journalFile);
+    try { journal.open(txnRepo, catRepo); } catch (const std::overflow_error&) {
+        std::cerr << "Amount out of range in " << dataFile << " or " << journalFile << ". Aborting.\n";
+        return 1;
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << ". Aborting.\n";
+        return 1;
+    }
+    // a failed journal write leaves the change in memory only; say so instead of claiming it was saved
+    auto commitJournal = [&] {
+        bool ok = journal.commit();
+        if (!ok) std::cout << "Warning: could not write " << journalFile << "; changes are only in memory.\n";
+        return ok;
+    };
+    // history before last year no longer changes: seal it into compressed blocks (it is still
+    // listed, searched and reported on, see TransactionRepository::sealBefore)
+    txnRepo.sealBefore(yearBounds(keyYear(monthKeyOf(std::chrono::system_clock::now())) - 1).first);
 
     CategorizerService categorizer(catRepo);
+    categorizer.train(txnRepo);
     BalanceService balanceSvc(txnRepo);
     TransactionService txnSvc(txnRepo, catRepo, categorizer, balanceSvc);
     ReportService reportSvc(txnRepo);
     SearchService searchSvc(txnRepo);
 
-    // load previous transactions if present (now categories are available for resolution)
-    txnRepo.loadFromCsv(dataFile, &catRepo);
-
     // interactive menu
-    int txnCount = (int)txnRepo.findAll().size() + 1;
+    int txnCount = (int)txnRepo.size() + 1;
     while (true) {
         std::cout << "\nSimple Ledger Menu:\n";
         std::cout << "1) Add transaction\n";
@@ -41,6 +67,12 @@ int main(){
     std::cout << "5) All-time category summary\n";
     std::cout << "6) Show balance\n";
     std::cout << "7) Manage categories\n";
+    std::cout << "8) Verify report aggregates\n";
+    std::cout << "9) Import statement (CSV)\n";
+#ifdef LEDGER_METRICS
+    std::cout << "10) Stats (latency and throughput)\n";
+#endif
+    std::cout << "11) Category chart for a date range / last N days\n";
         std::cout << "0) Exit\n";
         std::cout << "Select option: ";
         std::string opt;
@@ -54,17 +86,23 @@ int main(){
             std::cout << "Type (i=income, e=expense): "; std::getline(std::cin, type);
             std::string amountStr;
             std::cout << "Amount: "; std::getline(std::cin, amountStr);
-            double val = 0; try { val = std::stod(amountStr); } catch(...) { std::cout << "Invalid amount. Aborting add.\n"; continue; }
+            Decimal val;
+            size_t b = amountStr.find_first_not_of(" \t"), e = amountStr.find_last_not_of(" \t\r");
+            if (b == std::string::npos || !Decimal::parse(std::string_view(amountStr).substr(b, e + 1 - b), val) || val == Decimal::fromRaw(std::numeric_limits<int64_t>::min())) {
+                std::cout << "Invalid amount. Aborting add.\n"; continue;
+            }
+            if (val < 0) val = -val;
             std::string notes; std::cout << "Notes: "; std::getline(std::cin, notes);
             Transaction t; t.txnId = makeId("t", txnCount++);
-            t.amount = (type == "e" || type == "E") ? -std::abs(val) : std::abs(val);
+            t.amount = (type == "e" || type == "E") ? -val : val;
             t.date = std::chrono::system_clock::now(); t.merchant = merchant; t.notes = notes;
-            txnSvc.addTransaction(t);
-            txnRepo.saveToCsv(dataFile);
-            std::cout << "Transaction added and saved!\n";
+            try { txnSvc.addTransaction(t); } catch (const std::overflow_error&) { std::cout << "Amount out of range. Aborting add.\n"; continue; }
+            bool saved = commitJournal();
+            journal.maybeCompact();
+            std::cout << (saved ? "Transaction added and saved!\n" : "Transaction added.\n");
         } else if (opt == "2") {
             std::cout << "\nAll transactions:\n";
-            for (auto &t: txnRepo.findAll()){
+            for (const auto &t: txnRepo.findAll()){
                 auto tt = std::chrono::system_clock::to_time_t(t.date);
                 std::cout << t.txnId << " " << t.merchant << " " << t.amount << " ";
                 if (t.category) std::cout << "["<<t.category->name<<"]";
@@ -106,18 +144,18 @@ int main(){
                 Category c; c.categoryId = std::string("c_") + std::to_string(catRepo.all().size()+1);
                 c.name = name; c.type = (t=="i"||t=="I")?CategoryType::Income:CategoryType::Expense;
                 catRepo.save(c);
-                catRepo.saveToCsv(categoriesFile);
+                commitJournal();
                 std::cout << "Category added.\n";
             } else if (copt == "c") {
                 std::string name; std::cout << "Category name to delete: "; std::getline(std::cin, name);
                 if (!catRepo.remove(name)) {
                     std::cout << "Category not found.\n";
                 } else {
-                    // clear references in transactions
-                    txnRepo.clearCategory(name);
+                    // clear references in transactions, and what the categorizer learned from them
+                    txnSvc.clearCategory(name);
                     // persist both
-                    catRepo.saveToCsv(categoriesFile);
-                    txnRepo.saveToCsv(dataFile);
+                    commitJournal();
+                    journal.maybeCompact();
                     std::cout << "Category deleted; related transactions set to Uncategorized.\n";
                 }
             } else {
@@ -125,13 +163,57 @@ int main(){
             }
         } else if (opt == "6") {
             std::cout << "Balance: " << balanceSvc.calculateBalance() << "\n";
+        } else if (opt == "8") {
+            // recompute balance / monthly / per-category totals from scratch and compare
+            std::string problems;
+            if (txnRepo.verifyAggregates(&problems)) std::cout << "Aggregates consistent with " << txnRepo.size() << " transactions.\n";
+            else std::cout << "Aggregate mismatch:\n" << problems;
+        } else if (opt == "9") {
+            std::string path; std::cout << "Statement file: "; std::getline(std::cin, path);
+            ImportOptions io;
+            std::string window; std::cout << "Treat rows up to N seconds apart as the same transaction [0]: "; std::getline(std::cin, window);
+            io.dedup.window = std::atoll(window.c_str());
+            io.progress = [](const ImportStats& s) {
+                if (s.imported % (1 << 20) < 4096) std::cout << "  " << s.imported << " rows...\n";
+            };
+            ImportStats stats;
+            try { stats = txnSvc.importFromCsv(path, 0.8, io); } catch (const std::overflow_error&) {
+                commitJournal();
+                std::cout << "Amount out of range. Import stopped; rows before it were saved.\n"; continue;
+            }
+            commitJournal();
+            journal.maybeCompact();
+            std::cout << "Imported " << stats.imported << " transactions (" << stats.categorized << " auto-categorized, "
+                      << stats.rejected << " rejected, " << stats.duplicates << " duplicates skipped).\n";
+        } else if (opt == "11") {
+            std::string fromStr, toStr;
+            std::cout << "From (YYYY-MM-DD), or number of days back: "; std::getline(std::cin, fromStr);
+            int y = 0, m = 0, d = 0;
+            if (std::sscanf(fromStr.c_str(), "%d-%d-%d", &y, &m, &d) == 3) {
+                std::cout << "To (YYYY-MM-DD, exclusive): "; std::getline(std::cin, toStr);
+                int y2 = 0, m2 = 0, d2 = 0;
+                if (std::sscanf(toStr.c_str(), "%d-%d-%d", &y2, &m2, &d2) != 3) { std::cout << "Invalid date.\n"; continue; }
+                // local midnights; mktime normalizes the day within its month
+                int64_t from = localDayStart(monthBounds(y, m).first, d - 1), to = localDayStart(monthBounds(y2, m2).first, d2 - 1);
+                auto totals = reportSvc.incomeExpenseTotalsRange(from, to);
+                std::cout << "Income: " << totals.first << "  Expense: " << totals.second << "  Difference: " << (totals.first - totals.second) << "\n";
+                reportSvc.printCategoryChartRange(from, to);
+            } else {
+                int days = 0; try { days = std::stoi(fromStr); } catch(...) { std::cout << "Invalid input.\n"; continue; }
+                if (days <= 0) { std::cout << "Invalid input.\n"; continue; }
+                reportSvc.printCategoryChartLastDays(days);
+            }
+#ifdef LEDGER_METRICS
+        } else if (opt == "10") {
+            std::cout << "\n" << Metrics::instance().toText();
+#endif
         } else {
             std::cout << "Unknown option" << "\n";
         }
     }
 
     std::cout << "\nAll transactions:\n";
-    for (auto &t: txnRepo.findAll()){
+    for (const auto &t: txnRepo.findAll()){
         auto tt = std::chrono::system_clock::to_time_t(t.date);
         std::cout << t.txnId << " " << t.merchant << " " << t.amount << " ";
         if (t.category) std::cout << "["<<t.category->name<<"]";
@@ -156,5 +238,12 @@ int main(){
 
     std::cout << "\nBalance: " << balanceSvc.calculateBalance() << "\n";
 
+#ifdef LEDGER_METRICS
+    // everything measured this session, for whoever collects it
+    const std::string statsFile = "ledger_stats.json";
+    std::ofstream(statsFile, std::ios::trunc) << Metrics::instance().toJson();
+    std::cout << "Stats written to " << statsFile << "\n";
+#endif
+
     return 0;
 }